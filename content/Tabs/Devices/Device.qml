@@ -345,13 +345,7 @@ RowLayout {
             width: apps_info.cellWidth - 10
             height: apps_info.cellHeight - 10
             name: model.package_name
-            thumbnailPath: {
-                let path = app.vrp.getGameThumbnailPath(model.package_name);
-                if (path === "")
-                    return "qrc:/qt/qml/content/Image/matrix.png";
-                else
-                    return "file://" + path;
-            }
+            thumbnailPath: "image://thumbnail/" + model.package_name
             onUninstallButtonClicked: {
                 confirm_dialog.packageName = model.package_name;
                 confirm_dialog.index = index;
@@ -68,6 +68,16 @@ Kirigami.Card {
             progress_bar.indeterminate = false;
             status_label.color = "red";
             status_label.text = qsTr("DecompressionError");
+        } else if (status === VrpManager.InstallQueued) {
+            progress_bar.indeterminate = false;
+            delete_button.enabled = false;
+            status_label.color = Kirigami.Theme.textColor;
+            status_label.text = qsTr("Queued for install");
+        } else if (status === VrpManager.Installing) {
+            progress_bar.indeterminate = true;
+            delete_button.enabled = false;
+            status_label.color = Kirigami.Theme.textColor;
+            status_label.text = qsTr("Installing");
         } else {
             delete_button.enabled = false;
             progress_bar.indeterminate = false;
@@ -85,6 +95,7 @@ Kirigami.Card {
         height: parent.height - 20
         asynchronous: true
         source: thumbnailPath
+        sourceSize.height: height
         fillMode: Image.PreserveAspectFit
     }
 
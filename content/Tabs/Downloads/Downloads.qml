@@ -58,13 +58,7 @@ RowLayout {
                 height: 130
                 name: model.name
                 size: model.size
-                thumbnailPath: {
-                    let path = app.vrp.getGameThumbnailPath(model.package_name);
-                    if (path === "")
-                        return "qrc:/qt/qml/content/Image/matrix.png";
-                    else
-                        return "file://" + path;
-                }
+                thumbnailPath: "image://thumbnail/" + model.package_name
                 progress: 0
                 status: app.vrp.getStatus(model.game_info)
                 onDeleteButtonClicked: {
@@ -87,6 +81,12 @@ RowLayout {
 
                     }
 
+                    function onStatusesChanged(statuses_) {
+                        if (model.release_name in statuses_)
+                            status = statuses_[model.release_name];
+
+                    }
+
                     target: app.vrp
                 }
 
@@ -160,20 +160,22 @@ RowLayout {
                 height: 130
                 releaseName: model.release_name
                 size: model.size
-                thumbnailPath: {
-                    let path = app.vrp.getGameThumbnailPath(model.package_name);
-                    if (path === "")
-                        return "qrc:/qt/qml/content/Image/matrix.png";
-                    else
-                        return "file://" + path;
-                }
+                thumbnailPath: "image://thumbnail/" + model.package_name
                 status: app.vrp.getStatus(model.game_info)
+                pinned: app.vrp.isPinned(model.release_name)
                 onInstallButtonClicked: {
                     app.vrp.installQml(model.game_info);
                 }
+                onInstallToDevicesButtonClicked: {
+                    install_to_devices_dialog.game = model.game_info;
+                    install_to_devices_dialog.open();
+                }
                 onDeleteButtonClicked: {
                     local_list.model.remove(model.index);
                 }
+                onPinButtonToggled: function(pinned_) {
+                    app.vrp.setPinned(releaseName, pinned_);
+                }
                 onNameTextClicked: {
                     app.vrp.openGameFolderQml(model.release_name);
                 }
@@ -185,6 +187,25 @@ RowLayout {
 
                     }
 
+                    function onStatusesChanged(statuses_) {
+                        if (release_name in statuses_)
+                            status = statuses_[release_name];
+
+                    }
+
+                    function onInstallProgressChanged(release_name_, progress_, speed_) {
+                        if (release_name === release_name_) {
+                            installSpeed = speed_;
+                            installProgress = progress_;
+                        }
+                    }
+
+                    function onPinnedChanged(release_name_, pinned_) {
+                        if (release_name === release_name_)
+                            pinned = pinned_;
+
+                    }
+
                     target: app.vrp
                 }
 
@@ -194,4 +215,53 @@ RowLayout {
 
     }
 
+    Dialog {
+        id: install_to_devices_dialog
+
+        property var game
+
+        title: qsTr("Install To Devices")
+        modal: true
+        x: (parent.width - width) / 2
+        y: (parent.height - height) / 2
+        standardButtons: Dialog.Ok | Dialog.Cancel
+        onAccepted: {
+            let serials = [];
+            for (let i = 0; i < device_check_boxes.count; ++i) {
+                if (device_check_boxes.itemAt(i).checked)
+                    serials.push(device_check_boxes.itemAt(i).text);
+
+            }
+            if (serials.length <= 0)
+                return ;
+
+            let release_name = game.release_name;
+            app.vrp.installToDevicesQml(game, serials).then((results) => {
+                let failed = serials.filter((serial) => {
+                    return !results[serial];
+                });
+                if (failed.length > 0)
+                    app.showPassiveNotification(qsTr("Failed to install %1 on %2").arg(release_name).arg(failed.join(", ")));
+                else
+                    app.showPassiveNotification(qsTr("Installed %1 on %2 devices").arg(release_name).arg(serials.length));
+            });
+        }
+
+        ColumnLayout {
+            Repeater {
+                id: device_check_boxes
+
+                model: app.deviceManager.devicesList
+
+                CheckBox {
+                    text: modelData
+                    checked: true
+                }
+
+            }
+
+        }
+
+    }
+
 }
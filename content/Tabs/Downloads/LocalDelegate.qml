@@ -28,9 +28,14 @@ Kirigami.Card {
     property string releaseName
     property string thumbnailPath
     property var status
+    property real installProgress: 0
+    property real installSpeed: 0
+    property bool pinned: false
 
     signal installButtonClicked()
+    signal installToDevicesButtonClicked()
     signal deleteButtonClicked()
+    signal pinButtonToggled(bool pinned)
     signal nameTextClicked()
 
     onStatusChanged: function() {
@@ -48,6 +53,12 @@ Kirigami.Card {
             install_button.text = qsTr("Install");
             install_button.enabled = true;
             break;
+        case VrpManager.InstallQueued:
+            install_button.text = qsTr("Queued for install");
+            break;
+        case VrpManager.Staging:
+            install_button.text = qsTr("Staging...");
+            break;
         case VrpManager.Installing:
             install_button.text = qsTr("Installing...");
             break;
@@ -66,6 +77,12 @@ Kirigami.Card {
         }
     }
 
+    onInstallProgressChanged: function() {
+        if (status === VrpManager.Installing || status === VrpManager.Staging)
+            install_button.text = (status === VrpManager.Staging ? qsTr("Staging... %1% (%2 MB/s)") : qsTr("Installing... %1% (%2 MB/s)")).arg((installProgress * 100).toFixed(0)).arg((installSpeed / 1024 / 1024).toFixed(1));
+
+    }
+
     Image {
         id: thumbnail
 
@@ -75,6 +92,7 @@ Kirigami.Card {
         height: parent.height - 20
         asynchronous: true
         source: thumbnailPath
+        sourceSize.height: height
         fillMode: Image.PreserveAspectFit
     }
 
@@ -125,6 +143,41 @@ Kirigami.Card {
         }
     }
 
+    Button {
+        id: install_to_devices_button
+
+        hoverEnabled: true
+        anchors.left: install_button.right
+        anchors.bottom: parent.bottom
+        anchors.margins: 10
+        visible: app.deviceManager.devicesList.length > 1
+        text: qsTr("Install To...")
+        icon.name: "install"
+        ToolTip.text: qsTr("Install on several devices at once.")
+        ToolTip.visible: hovered
+        onClicked: {
+            installToDevicesButtonClicked();
+        }
+    }
+
+    Button {
+        id: pin_button
+
+        hoverEnabled: true
+        anchors.right: delete_button.left
+        anchors.bottom: parent.bottom
+        anchors.margins: 10
+        // Not checkable, toggling would break the binding and the state comes back through pinnedChanged
+        checked: pinned
+        text: checked ? qsTr("Pinned") : qsTr("Pin")
+        icon.name: "pin"
+        ToolTip.text: qsTr("Pinned games are kept on disk when the data quota is exceeded.")
+        ToolTip.visible: hovered
+        onClicked: {
+            pinButtonToggled(!pinned);
+        }
+    }
+
     Button {
         id: delete_button
 
@@ -97,6 +97,16 @@ Kirigami.Card {
             progress_bar.value = 1;
             action_button.icon.name = "install";
             break;
+        case VrpManager.InstallQueued:
+            action_button.text = qsTr("Queued for install");
+            progress_bar.value = 1;
+            progress_bar.visible = true;
+            break;
+        case VrpManager.Staging:
+            action_button.text = qsTr("Staging");
+            progress_bar.indeterminate = true;
+            progress_bar.visible = true;
+            break;
         case VrpManager.Installing:
             action_button.text = qsTr("Installing");
             progress_bar.indeterminate = true;
@@ -96,7 +96,7 @@ ColumnLayout {
                 Kirigami.Action {
                     displayComponent: RadioButton {
                         text: qsTr("Local")
-                        onClicked: app.vrp.filterGamesByStatus(VrpManager.Local | VrpManager.Installable | VrpManager.UpdatableLocally | VrpManager.Installing | VrpManager.InstallError | VrpManager.InstalledAndLocally)
+                        onClicked: app.vrp.filterGamesByStatus(VrpManager.Local | VrpManager.Installable | VrpManager.UpdatableLocally | VrpManager.InstallQueued | VrpManager.Staging | VrpManager.Installing | VrpManager.InstallError | VrpManager.InstalledAndLocally)
                     }
                 },
 
@@ -180,6 +180,113 @@ ColumnLayout {
                 ToolTip.visible: hovered
             }
 
+            CheckBox {
+                id: install_from_archive_setting
+
+                Kirigami.FormData.label: qsTr("Install From Archive:")
+                // Needs the 7za process to be paused while the device catches up, which is not possible on Windows
+                enabled: app.deviceManager.archiveInstallSupported
+                Component.onCompleted: {
+                    checked = app.vrp.settings.installFromArchive;
+                }
+                onClicked: {
+                    app.vrp.settings.installFromArchive = checked;
+                }
+                text: qsTr("Enable")
+                ToolTip.text: qsTr("Install downloaded games straight from the archive without decompressing them first. Needs a connected device.")
+                ToolTip.visible: hovered
+            }
+
+            TextField {
+                id: cache_quota_setting
+
+                Kirigami.FormData.label: qsTr("Cache Quota (MB):")
+                validator: IntValidator {
+                    bottom: 0
+                }
+                Component.onCompleted: {
+                    text = app.vrp.settings.cacheQuota;
+                }
+                // Applied once the value is complete, every keystroke would evict for the partial value
+                onEditingFinished: {
+                    app.vrp.settings.cacheQuota = parseInt(text) || 0;
+                }
+                placeholderText: qsTr("0 = unlimited")
+                ToolTip.text: qsTr("Least recently used downloads are deleted to keep the cache below this size. Pinned and busy games are kept. 0 means unlimited.")
+                ToolTip.visible: hovered
+            }
+
+            TextField {
+                id: data_quota_setting
+
+                Kirigami.FormData.label: qsTr("Data Quota (MB):")
+                validator: IntValidator {
+                    bottom: 0
+                }
+                Component.onCompleted: {
+                    text = app.vrp.settings.dataQuota;
+                }
+                onEditingFinished: {
+                    app.vrp.settings.dataQuota = parseInt(text) || 0;
+                }
+                placeholderText: qsTr("0 = unlimited")
+                ToolTip.text: qsTr("Least recently used decompressed games are deleted to keep the data path below this size. Pinned and busy games are kept. 0 means unlimited.")
+                ToolTip.visible: hovered
+            }
+
+            TextField {
+                id: renamed_apk_cache_size_setting
+
+                Kirigami.FormData.label: qsTr("Renamed APK Cache (MB):")
+                validator: IntValidator {
+                    bottom: 0
+                }
+                Component.onCompleted: {
+                    text = app.vrp.settings.renamedApkCacheSize;
+                }
+                onEditingFinished: {
+                    app.vrp.settings.renamedApkCacheSize = parseInt(text) || 0;
+                }
+                ToolTip.text: qsTr("Size limit of the renamed and signed APKs kept for reinstalling the same game.")
+                ToolTip.visible: hovered
+            }
+
+            TextField {
+                id: usb_bandwidth_limit_setting
+
+                Kirigami.FormData.label: qsTr("USB Bandwidth Limit (MB/s):")
+                validator: IntValidator {
+                    bottom: 0
+                }
+                Component.onCompleted: {
+                    text = app.vrp.settings.usbBandwidthLimit;
+                }
+                onEditingFinished: {
+                    app.vrp.settings.usbBandwidthLimit = parseInt(text) || 0;
+                }
+                placeholderText: qsTr("0 = unlimited")
+                ToolTip.text: qsTr("Upper bound for the total transfer rate when installing to several devices at once. 0 means unlimited.")
+                ToolTip.visible: hovered
+            }
+
+            TextField {
+                id: stall_timeout_setting
+
+                Kirigami.FormData.label: qsTr("Stall Timeout (s):")
+                validator: IntValidator {
+                    bottom: 0
+                }
+                Component.onCompleted: {
+                    text = app.vrp.settings.stallTimeout;
+                }
+                onEditingFinished: {
+                    app.vrp.settings.stallTimeout = parseInt(text) || 0;
+                }
+                placeholderText: qsTr("0 = never")
+                ToolTip.text: qsTr("adb and 7za processes that make no progress for this long are stopped. 0 never stops them.")
+                ToolTip.visible: hovered
+            }
+
             ComboBox {
                 id: theme_setting
 
@@ -231,13 +338,7 @@ ColumnLayout {
             size: modelData.size
             lastUpdated: modelData.last_updated
             versionCode: modelData.version_code
-            thumbnailPath: {
-                let path = app.vrp.getGameThumbnailPath(modelData.package_name);
-                if (path === "")
-                    return "qrc:/qt/qml/content/Image/matrix.png";
-                else
-                    return "file://" + path;
-            }
+            thumbnailPath: "image://thumbnail/" + modelData.package_name
             progress: 0
             status: app.vrp.getStatus(modelData)
             onInstallButtonClicked: {
@@ -260,6 +361,12 @@ ColumnLayout {
 
                 }
 
+                function onStatusesChanged(statuses_) {
+                    if (modelData.release_name in statuses_)
+                        status = statuses_[modelData.release_name];
+
+                }
+
                 target: app.vrp
             }
 
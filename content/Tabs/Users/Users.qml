@@ -153,13 +153,7 @@ RowLayout {
                     width: installed_apps.cellWidth - 10
                     height: installed_apps.cellHeight - 10
                     name: model.package_name
-                    thumbnailPath: {
-                        let path = app.vrp.getGameThumbnailPath(model.package_name);
-                        if (path === "")
-                            return "qrc:/qt/qml/content/Image/matrix.png";
-                        else
-                            return "file://" + path;
-                    }
+                    thumbnailPath: "image://thumbnail/" + model.package_name
                     onRemoveButtonClicked: {
                         remove_confirm_dialog.packageName = model.package_name;
                         remove_confirm_dialog.index = index;
@@ -201,13 +195,7 @@ RowLayout {
                     width: available_apps.cellWidth - 10
                     height: available_apps.cellHeight - 10
                     name: model.package_name
-                    thumbnailPath: {
-                        let path = app.vrp.getGameThumbnailPath(model.package_name);
-                        if (path === "")
-                            return "qrc:/qt/qml/content/Image/matrix.png";
-                        else
-                            return "file://" + path;
-                    }
+                    thumbnailPath: "image://thumbnail/" + model.package_name
                     onAddButtonClicked: {
                         confirm_dialog.packageName = model.package_name;
                         confirm_dialog.index = index;
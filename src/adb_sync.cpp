@@ -0,0 +1,299 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "adb_sync.h"
+
+#include <QCoroAbstractSocket>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+// https://android.googlesource.com/platform/packages/modules/adb/+/refs/heads/main/SYNC.TXT
+static constexpr int ADB_SERVER_PORT = 5037;
+static constexpr qint64 SYNC_DATA_MAX = 64 * 1024;
+static constexpr qint64 MAX_PENDING_WRITE = 4 * 1024 * 1024;
+static constexpr qint64 READ_CHUNK_SIZE = 1024 * 1024;
+static constexpr int TIMEOUT_MS = 30000;
+static constexpr int PROGRESS_INTERVAL_MS = 200;
+
+AdbSync::AdbSync(const QString &serial, QObject *parent)
+    : QObject(parent)
+    , serial_(serial)
+    , pending_acks_(0)
+    , bytes_sent_(0)
+    , in_file_(false)
+{
+}
+
+AdbSync::~AdbSync()
+{
+    socket_.abort();
+}
+
+QCoro::Task<bool> AdbSync::open()
+{
+    int port = qEnvironmentVariableIntValue("ANDROID_ADB_SERVER_PORT");
+    if (port <= 0) {
+        port = ADB_SERVER_PORT;
+    }
+
+    socket_.connectToHost("127.0.0.1", port);
+    if (!co_await qCoro(socket_).waitForConnected(TIMEOUT_MS)) {
+        setError("Failed to connect to adb server: " + socket_.errorString());
+        co_return false;
+    }
+
+    if (!co_await sendService("host:transport:" + serial_)) {
+        co_return false;
+    }
+
+    co_return co_await sendService("sync:");
+}
+
+QCoro::Task<bool> AdbSync::close()
+{
+    bool result = co_await flush(0) && co_await readAcknowledgements(true);
+
+    if (socket_.state() == QAbstractSocket::ConnectedState) {
+        writeRequest("QUIT", 0);
+        co_await flush(0);
+        socket_.disconnectFromHost();
+    }
+    co_return result;
+}
+
+QCoro::Task<bool> AdbSync::beginFile(const QString remote_path, int mode)
+{
+    if (in_file_) {
+        setError("Previous file was not finished");
+        co_return false;
+    }
+
+    QByteArray path_and_mode = remote_path.toUtf8() + "," + QByteArray::number(mode);
+    if (path_and_mode.size() > 1024) {
+        setError("Remote path too long: " + remote_path);
+        co_return false;
+    }
+
+    if (!writeRequest("SEND", path_and_mode.size(), path_and_mode)) {
+        co_return false;
+    }
+    in_file_ = true;
+    co_return true;
+}
+
+QCoro::Task<bool> AdbSync::writeData(const QByteArray data)
+{
+    for (qint64 offset = 0; offset < data.size(); offset += SYNC_DATA_MAX) {
+        QByteArray chunk = data.mid(offset, SYNC_DATA_MAX);
+        if (!writeRequest("DATA", chunk.size(), chunk)) {
+            co_return false;
+        }
+        bytes_sent_ += chunk.size();
+
+        if (!co_await flush(MAX_PENDING_WRITE)) {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+QCoro::Task<bool> AdbSync::endFile()
+{
+    if (!writeRequest("DONE", QDateTime::currentSecsSinceEpoch())) {
+        co_return false;
+    }
+    in_file_ = false;
+    ++pending_acks_;
+
+    // Don't wait for the device to acknowledge this file, the next one is sent right away
+    co_return co_await readAcknowledgements(false);
+}
+
+QCoro::Task<bool> AdbSync::push(const QList<QPair<QString, QString>> files)
+{
+    qint64 bytes_total = 0;
+    for (const auto &[local_path, remote_path] : files) {
+        bytes_total += QFileInfo(local_path).size();
+    }
+
+    if (!co_await open()) {
+        co_return false;
+    }
+
+    const qint64 bytes_start = bytes_sent_;
+    QElapsedTimer elapsed_timer;
+    QElapsedTimer progress_timer;
+    elapsed_timer.start();
+    progress_timer.start();
+
+    auto report = [&]() {
+        qint64 sent = bytes_sent_ - bytes_start;
+        double seconds = elapsed_timer.elapsed() / 1000.0;
+        emit progress(sent, bytes_total, seconds > 0 ? sent / seconds : 0.0);
+        progress_timer.restart();
+    };
+
+    report();
+    for (const auto &[local_path, remote_path] : files) {
+        QFile file(local_path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            setError("Failed to open " + local_path);
+            co_return false;
+        }
+
+        if (!co_await beginFile(remote_path)) {
+            co_return false;
+        }
+
+        while (!file.atEnd()) {
+            QByteArray data = file.read(READ_CHUNK_SIZE);
+            if (data.isEmpty()) {
+                setError("Failed to read " + local_path);
+                co_return false;
+            }
+
+            if (!co_await writeData(data)) {
+                co_return false;
+            }
+
+            if (progress_timer.elapsed() >= PROGRESS_INTERVAL_MS) {
+                report();
+            }
+        }
+
+        if (!co_await endFile()) {
+            co_return false;
+        }
+    }
+
+    bool result = co_await close();
+    report();
+    co_return result;
+}
+
+QCoro::Task<bool> AdbSync::sendService(const QString service)
+{
+    QByteArray request = service.toUtf8();
+    request.prepend(QByteArray::number(request.size(), 16).rightJustified(4, '0'));
+    socket_.write(request);
+
+    QByteArray status = co_await readBytes(4);
+    if (status == "OKAY") {
+        co_return true;
+    }
+
+    if (status == "FAIL") {
+        bool ok = false;
+        int length = (co_await readBytes(4)).toInt(&ok, 16);
+        setError(ok ? QString::fromUtf8(co_await readBytes(length)) : "Unknown adb server failure");
+    } else {
+        setError("Unexpected adb server response: " + QString::fromLatin1(status));
+    }
+    co_return false;
+}
+
+QCoro::Task<QByteArray> AdbSync::readBytes(qint64 size)
+{
+    while (socket_.bytesAvailable() < size) {
+        if (socket_.state() != QAbstractSocket::ConnectedState) {
+            break;
+        }
+
+        if (!co_await qCoro(socket_).waitForReadyRead(TIMEOUT_MS)) {
+            break;
+        }
+    }
+    co_return socket_.read(size);
+}
+
+QCoro::Task<bool> AdbSync::flush(qint64 max_pending)
+{
+    // A device that stops reading leaves the connection open, give up once nothing drains for a while
+    QElapsedTimer stalled_timer;
+    stalled_timer.start();
+    while (socket_.bytesToWrite() > max_pending) {
+        if (socket_.state() != QAbstractSocket::ConnectedState) {
+            setError("Connection to adb server lost: " + socket_.errorString());
+            co_return false;
+        }
+
+        const qint64 pending = socket_.bytesToWrite();
+        co_await qCoro(socket_).waitForBytesWritten(TIMEOUT_MS);
+        if (socket_.bytesToWrite() < pending) {
+            stalled_timer.restart();
+        } else if (stalled_timer.elapsed() >= TIMEOUT_MS) {
+            setError(QString("No data sent to adb server for %1 seconds").arg(TIMEOUT_MS / 1000));
+            co_return false;
+        }
+
+        // The device reports failures as soon as they happen, don't keep sending into a dead session
+        if (!co_await readAcknowledgements(false)) {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+QCoro::Task<bool> AdbSync::readAcknowledgements(bool wait_all)
+{
+    while (pending_acks_ > 0) {
+        if (!wait_all && socket_.bytesAvailable() < 8) {
+            co_return true;
+        }
+
+        QByteArray header = co_await readBytes(8);
+        if (header.size() < 8) {
+            setError("Connection to adb server closed");
+            co_return false;
+        }
+
+        quint32 length = qFromLittleEndian<quint32>(header.constData() + 4);
+        if (header.startsWith("OKAY")) {
+            --pending_acks_;
+        } else if (header.startsWith("FAIL")) {
+            setError(QString::fromUtf8(co_await readBytes(length)));
+            co_return false;
+        } else {
+            setError("Unexpected sync response: " + QString::fromLatin1(header.left(4)));
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+bool AdbSync::writeRequest(const char id[4], quint32 length, const QByteArray &payload)
+{
+    if (socket_.state() != QAbstractSocket::ConnectedState) {
+        setError("Not connected to adb server");
+        return false;
+    }
+
+    QByteArray request(id, 4);
+    request.resize(8);
+    qToLittleEndian<quint32>(length, request.data() + 4);
+    request.append(payload);
+    return socket_.write(request) == request.size();
+}
+
+void AdbSync::setError(const QString &error)
+{
+    error_string_ = error;
+    qWarning() << "adb sync" << serial_ << ":" << error;
+}
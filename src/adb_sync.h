@@ -0,0 +1,84 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_ADB_SYNC
+#define QROOKIE_ADB_SYNC
+
+#include <QCoroTask>
+#include <QElapsedTimer>
+#include <QList>
+#include <QPair>
+#include <QTcpSocket>
+
+// A client for the adb file sync protocol.
+// It talks to the local adb server directly, so a whole set of files can be
+// pushed over one sync session instead of spawning one `adb push` per file.
+class AdbSync : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AdbSync(const QString &serial, QObject *parent = nullptr);
+    ~AdbSync();
+
+    QString serial() const
+    {
+        return serial_;
+    }
+
+    // Connect to the adb server and switch the connection to sync mode
+    QCoro::Task<bool> open();
+    // Wait for all pending file acknowledgements and end the sync session
+    QCoro::Task<bool> close();
+
+    // Low level streaming API, a file is sent as beginFile, writeData..., endFile
+    QCoro::Task<bool> beginFile(const QString remote_path, int mode = 0644);
+    QCoro::Task<bool> writeData(const QByteArray data);
+    QCoro::Task<bool> endFile();
+
+    // Push local files (local path, remote path) back to back over one session
+    QCoro::Task<bool> push(const QList<QPair<QString, QString>> files);
+
+    qint64 bytesSent() const
+    {
+        return bytes_sent_;
+    }
+    QString errorString() const
+    {
+        return error_string_;
+    }
+
+signals:
+    void progress(qint64 bytes_sent, qint64 bytes_total, double bytes_per_second);
+
+private:
+    QCoro::Task<bool> sendService(const QString service);
+    QCoro::Task<QByteArray> readBytes(qint64 size);
+    QCoro::Task<bool> flush(qint64 max_pending);
+    QCoro::Task<bool> readAcknowledgements(bool wait_all);
+    bool writeRequest(const char id[4], quint32 length, const QByteArray &payload = QByteArray());
+    void setError(const QString &error);
+
+    QString serial_;
+    QTcpSocket socket_;
+    QString error_string_;
+    int pending_acks_;
+    qint64 bytes_sent_;
+    bool in_file_;
+};
+
+#endif /* QROOKIE_ADB_SYNC */
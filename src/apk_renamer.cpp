@@ -0,0 +1,487 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "apk_renamer.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QList>
+#include <QRegularExpression>
+#include <QtEndian>
+#include <zlib.h>
+
+// https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+static constexpr quint32 ZIP_LOCAL_HEADER_SIG = 0x04034b50;
+static constexpr quint32 ZIP_CENTRAL_HEADER_SIG = 0x02014b50;
+static constexpr quint32 ZIP_END_OF_CENTRAL_DIR_SIG = 0x06054b50;
+static constexpr int ZIP_LOCAL_HEADER_SIZE = 30;
+static constexpr int ZIP_CENTRAL_HEADER_SIZE = 46;
+static constexpr int ZIP_END_OF_CENTRAL_DIR_SIZE = 22;
+static constexpr quint16 ZIP_STORED = 0;
+static constexpr quint16 ZIP_DEFLATED = 8;
+static constexpr quint16 ZIP_DATA_DESCRIPTOR_FLAG = 0x0008;
+// Extra field apksigner and zipalign use to pad stored entries
+static constexpr quint16 ZIP_ALIGNMENT_EXTRA_ID = 0xd935;
+static constexpr int ZIP_ALIGNMENT = 4;
+static constexpr qint64 COPY_CHUNK_SIZE = 1024 * 1024;
+
+// https://android.googlesource.com/platform/frameworks/base/+/refs/heads/main/libs/androidfw/include/androidfw/ResourceTypes.h
+static constexpr quint16 RES_STRING_POOL_TYPE = 0x0001;
+static constexpr quint16 RES_XML_TYPE = 0x0003;
+static constexpr quint32 STRING_POOL_UTF8_FLAG = 1 << 8;
+static constexpr int STRING_POOL_HEADER_SIZE = 28;
+
+const QString MANIFEST_ENTRY("AndroidManifest.xml");
+
+template<typename T>
+static T readLe(const QByteArray &data, qint64 offset)
+{
+    return qFromLittleEndian<T>(data.constData() + offset);
+}
+
+template<typename T>
+static void writeLe(QByteArray &data, qint64 offset, T value)
+{
+    qToLittleEndian<T>(value, data.data() + offset);
+}
+
+template<typename T>
+static void appendLe(QByteArray &data, T value)
+{
+    data.resize(data.size() + sizeof(T));
+    qToLittleEndian<T>(value, data.data() + data.size() - sizeof(T));
+}
+
+static bool inflateRaw(const QByteArray &compressed, qint64 size, QByteArray &out)
+{
+    out.resize(size);
+    z_stream stream{};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return false;
+    }
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.constData()));
+    stream.avail_in = compressed.size();
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = out.size();
+    int ret = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    return ret == Z_STREAM_END && stream.total_out == uLong(size);
+}
+
+static bool deflateRaw(const QByteArray &data, QByteArray &out)
+{
+    z_stream stream{};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+
+    out.resize(deflateBound(&stream, data.size()));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = out.size();
+    int ret = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return ret == Z_STREAM_END;
+}
+
+static bool copyBytes(QFile &in, QFile &out, qint64 size)
+{
+    while (size > 0) {
+        QByteArray chunk = in.read(qMin(size, COPY_CHUNK_SIZE));
+        if (chunk.isEmpty() || out.write(chunk) != chunk.size()) {
+            return false;
+        }
+        size -= chunk.size();
+    }
+    return true;
+}
+
+// Old signatures would not match anymore, the renamed apk is signed again afterwards
+static bool isV1SignatureFile(const QString &name)
+{
+    static const QRegularExpression re("^META-INF/([^/]+\\.(SF|RSA|DSA|EC)|MANIFEST\\.MF)$", QRegularExpression::CaseInsensitiveOption);
+    return re.match(name).hasMatch();
+}
+
+// Read a length prefixed string of a string pool, see ResStringPool::stringAt
+static bool readPoolString(const QByteArray &pool, qint64 offset, bool utf8, QString &out)
+{
+    if (utf8) {
+        auto readLength = [&](qint64 &pos) -> qint64 {
+            if (pos >= pool.size()) {
+                return -1;
+            }
+            qint64 length = quint8(pool[pos++]);
+            if (length & 0x80) {
+                if (pos >= pool.size()) {
+                    return -1;
+                }
+                length = ((length & 0x7f) << 8) | quint8(pool[pos++]);
+            }
+            return length;
+        };
+
+        qint64 pos = offset;
+        // UTF-16 length first, then the UTF-8 byte count
+        if (readLength(pos) < 0) {
+            return false;
+        }
+        qint64 length = readLength(pos);
+        if (length < 0 || pos + length > pool.size()) {
+            return false;
+        }
+        out = QString::fromUtf8(pool.constData() + pos, length);
+        return true;
+    }
+
+    if (offset + 2 > pool.size()) {
+        return false;
+    }
+    qint64 length = readLe<quint16>(pool, offset);
+    offset += 2;
+    if (length & 0x8000) {
+        if (offset + 2 > pool.size()) {
+            return false;
+        }
+        length = ((length & 0x7fff) << 16) | readLe<quint16>(pool, offset);
+        offset += 2;
+    }
+    if (offset + length * 2 > pool.size()) {
+        return false;
+    }
+
+    out.resize(length);
+    for (qint64 i = 0; i < length; ++i) {
+        out[i] = QChar(readLe<quint16>(pool, offset + i * 2));
+    }
+    return true;
+}
+
+static void appendPoolString(QByteArray &data, const QString &str, bool utf8)
+{
+    if (utf8) {
+        auto appendLength = [&](qint64 length) {
+            if (length > 0x7f) {
+                data.append(char(0x80 | (length >> 8)));
+            }
+            data.append(char(length & 0xff));
+        };
+
+        QByteArray bytes = str.toUtf8();
+        appendLength(str.size());
+        appendLength(bytes.size());
+        data.append(bytes);
+        data.append('\0');
+        return;
+    }
+
+    if (str.size() > 0x7fff) {
+        appendLe<quint16>(data, 0x8000 | (str.size() >> 16));
+    }
+    appendLe<quint16>(data, str.size() & 0xffff);
+    for (QChar c : str) {
+        appendLe<quint16>(data, c.unicode());
+    }
+    appendLe<quint16>(data, 0);
+}
+
+bool ApkRenamer::patchManifest(QByteArray &axml, const QString &package_name, const QString &new_package_name)
+{
+    if (axml.size() < 8 + STRING_POOL_HEADER_SIZE || readLe<quint16>(axml, 0) != RES_XML_TYPE) {
+        qWarning() << "AndroidManifest.xml is not a binary xml file";
+        return false;
+    }
+
+    // The string pool is the first chunk of the document
+    const qint64 pool_start = readLe<quint16>(axml, 2);
+    if (pool_start + STRING_POOL_HEADER_SIZE > axml.size() || readLe<quint16>(axml, pool_start) != RES_STRING_POOL_TYPE) {
+        qWarning() << "AndroidManifest.xml has no string pool";
+        return false;
+    }
+
+    const quint16 header_size = readLe<quint16>(axml, pool_start + 2);
+    const quint32 pool_size = readLe<quint32>(axml, pool_start + 4);
+    const quint32 string_count = readLe<quint32>(axml, pool_start + 8);
+    const quint32 style_count = readLe<quint32>(axml, pool_start + 12);
+    const quint32 flags = readLe<quint32>(axml, pool_start + 16);
+    const quint32 strings_start = readLe<quint32>(axml, pool_start + 20);
+    const quint32 styles_start = readLe<quint32>(axml, pool_start + 24);
+    const bool utf8 = flags & STRING_POOL_UTF8_FLAG;
+
+    if (pool_start + pool_size > quint64(axml.size()) || header_size + (quint64(string_count) + style_count) * 4 > pool_size) {
+        qWarning() << "AndroidManifest.xml string pool is corrupted";
+        return false;
+    }
+
+    const QByteArray pool = axml.mid(pool_start, pool_size);
+    const qint64 strings_end = style_count > 0 ? styles_start : pool_size;
+
+    QByteArray strings;
+    QList<quint32> offsets;
+    bool changed = false;
+    for (quint32 i = 0; i < string_count; ++i) {
+        qint64 offset = strings_start + readLe<quint32>(pool, header_size + i * 4);
+        QString str;
+        if (offset >= strings_end || !readPoolString(pool, offset, utf8, str)) {
+            qWarning() << "AndroidManifest.xml string pool is corrupted";
+            return false;
+        }
+
+        if (str.contains(package_name)) {
+            str.replace(package_name, new_package_name);
+            changed = true;
+        }
+
+        offsets.append(strings.size());
+        appendPoolString(strings, str, utf8);
+    }
+
+    if (!changed) {
+        qWarning() << "Package name" << package_name << "not found in AndroidManifest.xml";
+        return false;
+    }
+
+    while (strings.size() % 4 != 0) {
+        strings.append('\0');
+    }
+
+    // Styles refer to strings by index, they are kept as they are
+    const QByteArray style_offsets = pool.mid(header_size + string_count * 4, style_count * 4);
+    const QByteArray styles = style_count > 0 ? pool.mid(styles_start) : QByteArray();
+
+    QByteArray new_pool = pool.left(header_size);
+    for (quint32 offset : offsets) {
+        appendLe<quint32>(new_pool, offset);
+    }
+    new_pool.append(style_offsets);
+    const quint32 new_strings_start = new_pool.size();
+    new_pool.append(strings);
+    const quint32 new_styles_start = style_count > 0 ? new_pool.size() : 0;
+    new_pool.append(styles);
+
+    writeLe<quint32>(new_pool, 4, new_pool.size());
+    writeLe<quint32>(new_pool, 20, new_strings_start);
+    writeLe<quint32>(new_pool, 24, new_styles_start);
+
+    axml.replace(pool_start, pool_size, new_pool);
+    writeLe<quint32>(axml, 4, axml.size());
+    return true;
+}
+
+bool ApkRenamer::rename(const QString &apk_path, const QString &new_apk_path, const QString &package_name, const QString &new_package_name)
+{
+    QFile in(apk_path);
+    if (!in.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open" << apk_path;
+        return false;
+    }
+
+    // Find the end of central directory record, it is followed by a comment of at most 64 KiB
+    const qint64 tail_size = qMin<qint64>(in.size(), ZIP_END_OF_CENTRAL_DIR_SIZE + 0xffff);
+    in.seek(in.size() - tail_size);
+    const QByteArray tail = in.read(tail_size);
+    qint64 eocd = -1;
+    for (qint64 i = tail.size() - ZIP_END_OF_CENTRAL_DIR_SIZE; i >= 0; --i) {
+        if (readLe<quint32>(tail, i) == ZIP_END_OF_CENTRAL_DIR_SIG) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0) {
+        qWarning() << apk_path << "is not a zip file";
+        return false;
+    }
+
+    const quint16 entry_count = readLe<quint16>(tail, eocd + 10);
+    const quint32 cd_size = readLe<quint32>(tail, eocd + 12);
+    const quint32 cd_offset = readLe<quint32>(tail, eocd + 16);
+    if (entry_count == 0xffff || cd_size == 0xffffffff || cd_offset == 0xffffffff) {
+        qWarning() << "Zip64 is not supported:" << apk_path;
+        return false;
+    }
+
+    in.seek(cd_offset);
+    const QByteArray cd = in.read(cd_size);
+    if (cd.size() != qint64(cd_size)) {
+        qWarning() << "Failed to read central directory of" << apk_path;
+        return false;
+    }
+
+    QFile out(new_apk_path);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to open" << new_apk_path;
+        return false;
+    }
+
+    QByteArray new_cd;
+    quint16 new_entry_count = 0;
+    bool manifest_patched = false;
+    qint64 pos = 0;
+    for (quint16 i = 0; i < entry_count; ++i) {
+        if (pos + ZIP_CENTRAL_HEADER_SIZE > cd.size() || readLe<quint32>(cd, pos) != ZIP_CENTRAL_HEADER_SIG) {
+            qWarning() << "Corrupted central directory in" << apk_path;
+            return false;
+        }
+
+        const quint16 name_length = readLe<quint16>(cd, pos + 28);
+        const quint16 extra_length = readLe<quint16>(cd, pos + 30);
+        const quint16 comment_length = readLe<quint16>(cd, pos + 32);
+        const qint64 record_size = ZIP_CENTRAL_HEADER_SIZE + name_length + extra_length + comment_length;
+        QByteArray record = cd.mid(pos, record_size);
+        pos += record_size;
+
+        const QByteArray name = record.mid(ZIP_CENTRAL_HEADER_SIZE, name_length);
+        if (isV1SignatureFile(QString::fromUtf8(name))) {
+            continue;
+        }
+
+        quint16 method = readLe<quint16>(record, 10);
+        quint32 crc = readLe<quint32>(record, 16);
+        quint32 compressed_size = readLe<quint32>(record, 20);
+        quint32 uncompressed_size = readLe<quint32>(record, 24);
+        const quint32 local_offset = readLe<quint32>(record, 42);
+        if (compressed_size == 0xffffffff || uncompressed_size == 0xffffffff || local_offset == 0xffffffff) {
+            qWarning() << "Zip64 is not supported:" << apk_path;
+            return false;
+        }
+
+        // Skip the original local header, a fresh one is written below
+        in.seek(local_offset);
+        const QByteArray local_header = in.read(ZIP_LOCAL_HEADER_SIZE);
+        if (local_header.size() != ZIP_LOCAL_HEADER_SIZE || readLe<quint32>(local_header, 0) != ZIP_LOCAL_HEADER_SIG) {
+            qWarning() << "Corrupted local header in" << apk_path;
+            return false;
+        }
+        const qint64 data_offset = local_offset + ZIP_LOCAL_HEADER_SIZE + readLe<quint16>(local_header, 26) + readLe<quint16>(local_header, 28);
+
+        QByteArray data;
+        const bool is_manifest = name == MANIFEST_ENTRY.toUtf8();
+        if (is_manifest) {
+            in.seek(data_offset);
+            QByteArray raw = in.read(compressed_size);
+            if (method == ZIP_DEFLATED) {
+                if (!inflateRaw(raw, uncompressed_size, data)) {
+                    qWarning() << "Failed to inflate AndroidManifest.xml of" << apk_path;
+                    return false;
+                }
+            } else if (method == ZIP_STORED) {
+                data = raw;
+            } else {
+                qWarning() << "Unsupported compression method" << method << "for AndroidManifest.xml";
+                return false;
+            }
+
+            if (!patchManifest(data, package_name, new_package_name)) {
+                return false;
+            }
+            manifest_patched = true;
+
+            crc = crc32(0L, reinterpret_cast<const Bytef *>(data.constData()), data.size());
+            uncompressed_size = data.size();
+            if (method == ZIP_DEFLATED) {
+                QByteArray deflated;
+                if (!deflateRaw(data, deflated)) {
+                    qWarning() << "Failed to deflate AndroidManifest.xml";
+                    return false;
+                }
+                data = deflated;
+            }
+            compressed_size = data.size();
+        }
+
+        const qint64 new_local_offset = out.pos();
+        if (new_local_offset > 0xfffffffe) {
+            qWarning() << "Zip64 is not supported:" << new_apk_path;
+            return false;
+        }
+
+        // Stored entries can be mmapped by the package manager, align their data
+        QByteArray extra;
+        if (method == ZIP_STORED) {
+            const qint64 header_end = new_local_offset + ZIP_LOCAL_HEADER_SIZE + name_length + 6;
+            const int padding = (ZIP_ALIGNMENT - header_end % ZIP_ALIGNMENT) % ZIP_ALIGNMENT;
+            appendLe<quint16>(extra, ZIP_ALIGNMENT_EXTRA_ID);
+            appendLe<quint16>(extra, 2 + padding);
+            appendLe<quint16>(extra, ZIP_ALIGNMENT);
+            extra.append(padding, '\0');
+        }
+
+        const quint16 flags = readLe<quint16>(record, 8) & ~ZIP_DATA_DESCRIPTOR_FLAG;
+        QByteArray header;
+        appendLe<quint32>(header, ZIP_LOCAL_HEADER_SIG);
+        appendLe<quint16>(header, readLe<quint16>(record, 6));
+        appendLe<quint16>(header, flags);
+        appendLe<quint16>(header, method);
+        appendLe<quint16>(header, readLe<quint16>(record, 12));
+        appendLe<quint16>(header, readLe<quint16>(record, 14));
+        appendLe<quint32>(header, crc);
+        appendLe<quint32>(header, compressed_size);
+        appendLe<quint32>(header, uncompressed_size);
+        appendLe<quint16>(header, name_length);
+        appendLe<quint16>(header, extra.size());
+        header.append(name);
+        header.append(extra);
+
+        if (out.write(header) != header.size()) {
+            qWarning() << "Failed to write" << new_apk_path;
+            return false;
+        }
+
+        if (is_manifest) {
+            if (out.write(data) != data.size()) {
+                qWarning() << "Failed to write" << new_apk_path;
+                return false;
+            }
+        } else {
+            in.seek(data_offset);
+            if (!copyBytes(in, out, compressed_size)) {
+                qWarning() << "Failed to copy" << name << "to" << new_apk_path;
+                return false;
+            }
+        }
+
+        writeLe<quint16>(record, 8, flags);
+        writeLe<quint32>(record, 16, crc);
+        writeLe<quint32>(record, 20, compressed_size);
+        writeLe<quint32>(record, 24, uncompressed_size);
+        writeLe<quint32>(record, 42, new_local_offset);
+        new_cd.append(record);
+        ++new_entry_count;
+    }
+
+    if (!manifest_patched) {
+        qWarning() << "No AndroidManifest.xml in" << apk_path;
+        return false;
+    }
+
+    // The apk signing block of the original file is not copied, it sits between the entries and the central directory
+    const qint64 new_cd_offset = out.pos();
+    QByteArray end_record = tail.mid(eocd);
+    writeLe<quint16>(end_record, 8, new_entry_count);
+    writeLe<quint16>(end_record, 10, new_entry_count);
+    writeLe<quint32>(end_record, 12, new_cd.size());
+    writeLe<quint32>(end_record, 16, new_cd_offset);
+
+    if (out.write(new_cd) != new_cd.size() || out.write(end_record) != end_record.size()) {
+        qWarning() << "Failed to write" << new_apk_path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_APK_RENAMER
+#define QROOKIE_APK_RENAMER
+
+#include <QByteArray>
+#include <QString>
+
+// Renames the package of an apk without decoding it.
+// The binary AndroidManifest.xml is patched in place (only its string pool changes),
+// every other entry is copied as is, stored entries are 4-byte aligned like zipalign does,
+// and the old v1 signature files are dropped. The result still has to be signed.
+class ApkRenamer
+{
+public:
+    // Blocking, meant to be run off the main thread
+    static bool rename(const QString &apk_path, const QString &new_apk_path, const QString &package_name, const QString &new_package_name);
+
+    // Replace package_name by new_package_name in every string of a binary xml string pool
+    static bool patchManifest(QByteArray &axml, const QString &package_name, const QString &new_package_name);
+};
+
+#endif /* QROOKIE_APK_RENAMER */
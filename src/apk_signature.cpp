@@ -0,0 +1,127 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "apk_signature.h"
+
+#include <QFile>
+#include <QtEndian>
+
+// https://source.android.com/docs/security/features/apksigning/v2#apk-signing-block
+static constexpr quint32 ZIP_END_OF_CENTRAL_DIR_SIG = 0x06054b50;
+static constexpr int ZIP_END_OF_CENTRAL_DIR_SIZE = 22;
+static constexpr quint32 APK_SIGNATURE_SCHEME_V2_ID = 0x7109871a;
+static constexpr quint32 APK_SIGNATURE_SCHEME_V3_ID = 0xf05368c0;
+static constexpr char APK_SIGNING_BLOCK_MAGIC[] = "APK Sig Block 42";
+static constexpr qint64 APK_SIGNING_BLOCK_MAX_SIZE = 64 * 1024 * 1024;
+
+// Take a uint32 length prefixed field from the front of data
+static bool takeLengthPrefixed(QByteArray &data, QByteArray &out)
+{
+    if (data.size() < 4) {
+        return false;
+    }
+
+    quint32 length = qFromLittleEndian<quint32>(data.constData());
+    if (length > quint32(data.size() - 4)) {
+        return false;
+    }
+
+    out = data.mid(4, length);
+    data.remove(0, 4 + length);
+    return true;
+}
+
+// First certificate of the first signer, the layout of a signer is the same for v2 and v3
+static QByteArray firstCertificate(QByteArray value)
+{
+    QByteArray signers, signer, signed_data, digests, certificates, certificate;
+    if (takeLengthPrefixed(value, signers) && takeLengthPrefixed(signers, signer) && takeLengthPrefixed(signer, signed_data)
+        && takeLengthPrefixed(signed_data, digests) && takeLengthPrefixed(signed_data, certificates) && takeLengthPrefixed(certificates, certificate)) {
+        return certificate;
+    }
+    return {};
+}
+
+QByteArray ApkSignature::signingCertificate(const QString &apk_path)
+{
+    QFile file(apk_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    const qint64 tail_size = qMin<qint64>(file.size(), ZIP_END_OF_CENTRAL_DIR_SIZE + 0xffff);
+    file.seek(file.size() - tail_size);
+    const QByteArray tail = file.read(tail_size);
+
+    qint64 cd_offset = -1;
+    for (qint64 i = tail.size() - ZIP_END_OF_CENTRAL_DIR_SIZE; i >= 0; --i) {
+        if (qFromLittleEndian<quint32>(tail.constData() + i) == ZIP_END_OF_CENTRAL_DIR_SIG) {
+            cd_offset = qFromLittleEndian<quint32>(tail.constData() + i + 16);
+            break;
+        }
+    }
+
+    // The signing block sits right before the central directory and ends with its size and magic
+    if (cd_offset < 32 || !file.seek(cd_offset - 24)) {
+        return {};
+    }
+    const QByteArray footer = file.read(24);
+    if (footer.size() != 24 || footer.mid(8) != QByteArray(APK_SIGNING_BLOCK_MAGIC)) {
+        return {};
+    }
+
+    const qint64 block_size = qFromLittleEndian<quint64>(footer.constData());
+    if (block_size < 24 || block_size > APK_SIGNING_BLOCK_MAX_SIZE || block_size + 8 > cd_offset) {
+        return {};
+    }
+
+    // id-value pairs, between the leading size field and the footer
+    file.seek(cd_offset - block_size);
+    const QByteArray pairs = file.read(block_size - 24);
+
+    QByteArray v2_value;
+    QByteArray v3_value;
+    for (qint64 pos = 0; pos + 12 <= pairs.size();) {
+        const quint64 length = qFromLittleEndian<quint64>(pairs.constData() + pos);
+        if (length < 4 || length > quint64(pairs.size() - pos - 8)) {
+            return {};
+        }
+
+        const quint32 id = qFromLittleEndian<quint32>(pairs.constData() + pos + 8);
+        if (id == APK_SIGNATURE_SCHEME_V2_ID) {
+            v2_value = pairs.mid(pos + 12, length - 4);
+        } else if (id == APK_SIGNATURE_SCHEME_V3_ID) {
+            v3_value = pairs.mid(pos + 12, length - 4);
+        }
+        pos += 8 + length;
+    }
+
+    // v3 carries the current signer when the key was rotated, it's what the device records
+    if (!v3_value.isEmpty()) {
+        return firstCertificate(v3_value);
+    }
+    return firstCertificate(v2_value);
+}
+
+QString ApkSignature::packageManagerDigest(const QByteArray &certificate)
+{
+    qint32 hash = 1;
+    for (char byte : certificate) {
+        hash = qint32(quint32(hash) * 31u + quint32(qint32(qint8(byte))));
+    }
+    return QString::number(quint32(hash), 16);
+}
@@ -0,0 +1,37 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_APK_SIGNATURE
+#define QROOKIE_APK_SIGNATURE
+
+#include <QByteArray>
+#include <QString>
+
+class ApkSignature
+{
+public:
+    // DER encoded certificate of the first signer in the APK Signing Block (v3, then v2).
+    // Empty for apks that are only v1 signed or can't be read.
+    static QByteArray signingCertificate(const QString &apk_path);
+
+    // The certificate digest `dumpsys package` prints in "signatures:[...]", that is
+    // Integer.toHexString(Arrays.hashCode(certificate)) on the device
+    static QString packageManagerDigest(const QByteArray &certificate);
+};
+
+#endif /* QROOKIE_APK_SIGNATURE */
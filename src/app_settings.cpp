@@ -33,6 +33,12 @@ AppSettings::AppSettings(QObject *parent)
     , keystore_path_(QString())
     , last_wireless_addr_(QString())
     , theme_(QString())
+    , usb_bandwidth_limit_(0)
+    , install_from_archive_(false)
+    , renamed_apk_cache_size_(4096)
+    , stall_timeout_(120)
+    , cache_quota_(0)
+    , data_quota_(0)
 {
     loadAppSettings();
 }
@@ -82,6 +88,13 @@ void AppSettings::loadAppSettings()
         theme_ = "Universal";
 #endif
     }
+
+    usb_bandwidth_limit_ = settings_->value("usb_bandwidth_limit", usb_bandwidth_limit_).toInt();
+    install_from_archive_ = settings_->value("install_from_archive", install_from_archive_).toBool();
+    renamed_apk_cache_size_ = settings_->value("renamed_apk_cache_size", renamed_apk_cache_size_).toInt();
+    stall_timeout_ = settings_->value("stall_timeout", stall_timeout_).toInt();
+    cache_quota_ = settings_->value("cache_quota", cache_quota_).toInt();
+    data_quota_ = settings_->value("data_quota", data_quota_).toInt();
 }
 
 void AppSettings::setAutoInstall(bool auto_install)
@@ -147,3 +160,45 @@ void AppSettings::setTheme(const QString &theme)
     settings_->setValue("theme", theme_);
     emit themeChanged(theme);
 }
+
+void AppSettings::setUsbBandwidthLimit(int usb_bandwidth_limit)
+{
+    usb_bandwidth_limit_ = usb_bandwidth_limit;
+    settings_->setValue("usb_bandwidth_limit", usb_bandwidth_limit_);
+    emit usbBandwidthLimitChanged(usb_bandwidth_limit);
+}
+
+void AppSettings::setInstallFromArchive(bool install_from_archive)
+{
+    install_from_archive_ = install_from_archive;
+    settings_->setValue("install_from_archive", install_from_archive_);
+    emit installFromArchiveChanged(install_from_archive);
+}
+
+void AppSettings::setRenamedApkCacheSize(int renamed_apk_cache_size)
+{
+    renamed_apk_cache_size_ = renamed_apk_cache_size;
+    settings_->setValue("renamed_apk_cache_size", renamed_apk_cache_size_);
+    emit renamedApkCacheSizeChanged(renamed_apk_cache_size);
+}
+
+void AppSettings::setStallTimeout(int stall_timeout)
+{
+    stall_timeout_ = stall_timeout;
+    settings_->setValue("stall_timeout", stall_timeout_);
+    emit stallTimeoutChanged(stall_timeout);
+}
+
+void AppSettings::setCacheQuota(int cache_quota)
+{
+    cache_quota_ = cache_quota;
+    settings_->setValue("cache_quota", cache_quota_);
+    emit cacheQuotaChanged(cache_quota);
+}
+
+void AppSettings::setDataQuota(int data_quota)
+{
+    data_quota_ = data_quota;
+    settings_->setValue("data_quota", data_quota_);
+    emit dataQuotaChanged(data_quota);
+}
@@ -32,6 +32,12 @@ class AppSettings : public QObject
     Q_PROPERTY(QString dataPath READ dataPath WRITE setDataPath NOTIFY dataPathChanged)
     Q_PROPERTY(QString lastWirelessAddr READ lastWirelessAddr WRITE setLastWirelessAddr NOTIFY lastWirelessAddrChanged)
     Q_PROPERTY(QString theme READ theme WRITE setTheme NOTIFY themeChanged)
+    Q_PROPERTY(int usbBandwidthLimit READ usbBandwidthLimit WRITE setUsbBandwidthLimit NOTIFY usbBandwidthLimitChanged)
+    Q_PROPERTY(bool installFromArchive READ installFromArchive WRITE setInstallFromArchive NOTIFY installFromArchiveChanged)
+    Q_PROPERTY(int renamedApkCacheSize READ renamedApkCacheSize WRITE setRenamedApkCacheSize NOTIFY renamedApkCacheSizeChanged)
+    Q_PROPERTY(int stallTimeout READ stallTimeout WRITE setStallTimeout NOTIFY stallTimeoutChanged)
+    Q_PROPERTY(int cacheQuota READ cacheQuota WRITE setCacheQuota NOTIFY cacheQuotaChanged)
+    Q_PROPERTY(int dataQuota READ dataQuota WRITE setDataQuota NOTIFY dataQuotaChanged)
 
 public:
     explicit AppSettings(QObject *parent = nullptr);
@@ -88,6 +94,48 @@ public:
     }
     void setTheme(const QString &theme);
 
+    // Upper bound for the total push rate of this host in MB/s, 0 means unlimited
+    int usbBandwidthLimit() const
+    {
+        return usb_bandwidth_limit_;
+    }
+    void setUsbBandwidthLimit(int usb_bandwidth_limit);
+
+    // Install downloaded games straight from the archive instead of extracting them first
+    bool installFromArchive() const
+    {
+        return install_from_archive_;
+    }
+    void setInstallFromArchive(bool install_from_archive);
+
+    // Size limit of the renamed apk cache in MB
+    int renamedApkCacheSize() const
+    {
+        return renamed_apk_cache_size_;
+    }
+    void setRenamedApkCacheSize(int renamed_apk_cache_size);
+
+    // Seconds without progress after which an adb or 7za process is considered stalled and killed
+    int stallTimeout() const
+    {
+        return stall_timeout_;
+    }
+    void setStallTimeout(int stall_timeout);
+
+    // Size budget of the downloaded volumes in the cache path in MB, 0 means unlimited
+    int cacheQuota() const
+    {
+        return cache_quota_;
+    }
+    void setCacheQuota(int cache_quota);
+
+    // Size budget of the extracted games in the data path in MB, 0 means unlimited
+    int dataQuota() const
+    {
+        return data_quota_;
+    }
+    void setDataQuota(int data_quota);
+
 signals:
     void autoInstallChanged(bool auto_install);
     void autoCleanCacheChanged(bool auto_clean_cache);
@@ -97,6 +145,12 @@ signals:
     void keyStorePathChanged(QString keystore_path);
     void lastWirelessAddrChanged(QString addr);
     void themeChanged(QString theme);
+    void usbBandwidthLimitChanged(int usb_bandwidth_limit);
+    void installFromArchiveChanged(bool install_from_archive);
+    void renamedApkCacheSizeChanged(int renamed_apk_cache_size);
+    void stallTimeoutChanged(int stall_timeout);
+    void cacheQuotaChanged(int cache_quota);
+    void dataQuotaChanged(int data_quota);
 
 private:
     void loadAppSettings();
@@ -110,6 +164,12 @@ private:
     QString keystore_path_;
     QString last_wireless_addr_;
     QString theme_;
+    int usb_bandwidth_limit_;
+    bool install_from_archive_;
+    int renamed_apk_cache_size_;
+    int stall_timeout_;
+    int cache_quota_;
+    int data_quota_;
 };
 
 #endif /* QROOKIE_APP_SETTINGS */
@@ -16,32 +16,88 @@
  */
 
 #include "device_manager.h"
+#include "adb_sync.h"
+#include "apk_renamer.h"
+#include "apk_signature.h"
 #include "app_settings.h"
 #include "models/game_info.h"
+#include "process_watchdog.h"
+#include "renamed_apk_cache.h"
+#include "seven_zip.h"
+#include "worker_thread.h"
 
 #include <QCoreApplication>
 #include <QCoroTask>
+#include <QCoroTimer>
 #include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QProcess>
 #include <QRegularExpression>
+#include <QSaveFile>
 #include <QSharedPointer>
 #include <QStandardPaths>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#endif
 
 const QString ADB("adb");
 const QString APKTOOL("apktool");
 const QString APKSIGNER("apksigner");
 const QString ZIPALIGN("zipalign");
+const QString DEVICE_STAGING_DIR("/data/local/tmp/qrookie");
+static constexpr qint64 DEVICE_SPACE_MARGIN = 256 * 1024 * 1024;
+// The package manager verifies an apk without any output, for minutes on multi GB apks
+static constexpr int PACKAGE_VERIFY_STALL_TIMEOUT_MS = 30 * 60 * 1000;
+
+// Stall timeout for processes that end with the package manager verifying an apk, 0 if the watchdog is turned off
+static int installStallTimeout()
+{
+    const int stall_timeout_ms = AppSettings::instance()->stallTimeout() * 1000;
+    return stall_timeout_ms > 0 ? qMax(stall_timeout_ms, PACKAGE_VERIFY_STALL_TIMEOUT_MS) : 0;
+}
+
+// Stall timeout for adb push, which prints nothing without a tty and only shows progress in its I/O
+static int pushStallTimeout()
+{
+    return ProcessWatchdog::watchesIo() ? 0 : installStallTimeout();
+}
 
 DeviceManager::DeviceManager(QObject *parent)
     : QObject(parent)
     , total_space_(0)
     , free_space_(0)
+    , last_install_job_id_(0)
 {
     connect(&auto_update_timer_, &QTimer::timeout, this, &DeviceManager::updateSerials);
+    // Show the last known state first, the queries below revalidate it
+    connect(this, &DeviceManager::connectedDeviceChanged, this, &DeviceManager::restoreDeviceState);
     connect(this, &DeviceManager::connectedDeviceChanged, this, &DeviceManager::updateDeviceInfo);
     connect(this, &DeviceManager::connectedDeviceChanged, this, &DeviceManager::updateUsers);
     connect(this, &DeviceManager::userInfoChanged, this, &DeviceManager::listPackagesForUser);
+
+    // Coalesce the burst of updates after a (re)connect into one write
+    save_state_timer_.setSingleShot(true);
+    save_state_timer_.setInterval(1000);
+    connect(&save_state_timer_, &QTimer::timeout, this, &DeviceManager::saveDeviceState);
+    connect(this, &DeviceManager::deviceNameChanged, &save_state_timer_, qOverload<>(&QTimer::start));
+    connect(this, &DeviceManager::oculusOsVersionChanged, &save_state_timer_, qOverload<>(&QTimer::start));
+    connect(this, &DeviceManager::oculusVersionChanged, &save_state_timer_, qOverload<>(&QTimer::start));
+    connect(this, &DeviceManager::oculusRuntimeVersionChanged, &save_state_timer_, qOverload<>(&QTimer::start));
+    connect(this, &DeviceManager::androidVersionChanged, &save_state_timer_, qOverload<>(&QTimer::start));
+    connect(this, &DeviceManager::androidSdkVersionChanged, &save_state_timer_, qOverload<>(&QTimer::start));
+    connect(this, &DeviceManager::spaceUsageChanged, &save_state_timer_, qOverload<>(&QTimer::start));
+    connect(this, &DeviceManager::appListChanged, &save_state_timer_, qOverload<>(&QTimer::start));
+    connect(this, &DeviceManager::usersListChanged, &save_state_timer_, qOverload<>(&QTimer::start));
+    connect(this, &DeviceManager::userAppsListChanged, &save_state_timer_, qOverload<>(&QTimer::start));
 }
 
 DeviceManager::~DeviceManager()
@@ -93,6 +149,155 @@ void DeviceManager::updateDeviceInfo()
     updateAppList();
 }
 
+static QString deviceStatePath(const QString &serial)
+{
+    // Wireless serials are host:port
+    QString file_name = serial;
+    file_name.replace(QRegularExpression("[^A-Za-z0-9._-]"), "_");
+    return AppSettings::instance()->dataPath() + "/devices/" + file_name + ".json";
+}
+
+static QJsonArray appsToJson(const QList<GameInfo> &list)
+{
+    QJsonArray apps;
+    for (const auto &app : list) {
+        apps.append(QJsonObject{{"package_name", app.package_name}, {"version_code", app.version_code}});
+    }
+    return apps;
+}
+
+static QList<GameInfo> appsFromJson(const QJsonArray &json)
+{
+    QList<GameInfo> apps;
+    for (const auto &value : json) {
+        auto obj = value.toObject();
+        GameInfo app{.package_name = obj["package_name"].toString(), .version_code = obj["version_code"].toString()};
+        app.intern();
+        apps.append(app);
+    }
+    return apps;
+}
+
+void DeviceManager::restoreDeviceState()
+{
+    if (!hasConnectedDevice()) {
+        return;
+    }
+    const QString serial = connectedDevice();
+
+    QFile file(deviceStatePath(serial));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QJsonObject state = QJsonDocument::fromJson(file.readAll()).object();
+    if (state.isEmpty()) {
+        return;
+    }
+    qDebug() << "Restoring last known state of device" << serial;
+
+    setDeviceName(state["device_name"].toString());
+    setOculusOsVersion(state["oculus_os_version"].toString());
+    setOculusVersion(state["oculus_version"].toString());
+    setOculusRuntimeVersion(state["oculus_runtime_version"].toString());
+    setAndroidVersion(state["android_version"].toInt());
+    setAndroidSdkVersion(state["android_sdk_version"].toInt());
+    setSpaceUsage(state["total_space"].toInteger(), state["free_space"].toInteger());
+    setAppList(serial, appsFromJson(state["packages"].toArray()));
+
+    const QJsonArray users = state["users"].toArray();
+    if (users.isEmpty()) {
+        return;
+    }
+
+    users_list_.clear();
+    selected_user_.reset();
+    user_packages_.clear();
+    user_packages_serial_ = serial;
+    const int selected_user_id = state["selected_user"].toInt(-1);
+    QList<GameInfo> selected_user_apps;
+    for (const auto &value : users) {
+        auto obj = value.toObject();
+        auto user = QSharedPointer<User>(new User(obj["id"].toInt(), obj["name"].toString(), obj["running"].toBool()));
+        users_list_.append(user);
+
+        if (user->running) {
+            running_user_name_ = user->name;
+        }
+
+        if (obj.contains("packages")) {
+            user_packages_[user->id] = appsFromJson(obj["packages"].toArray());
+            user->installedApps = user_packages_[user->id].size();
+            if (user->id == selected_user_id) {
+                selected_user_ = user;
+                selected_user_apps = user_packages_[user->id];
+            }
+        }
+    }
+
+    emit usersListChanged();
+
+    // Without a selected user updateUsers picks one once the users are known
+    if (selected_user_) {
+        user_apps_list_model_.syncByPackageName(selected_user_apps);
+        user_apps_list_owner_ = serial + "/" + QString::number(selected_user_->id);
+        updateAvailableAppsList();
+        emit userAppsListChanged();
+        emit userInfoChanged();
+    }
+}
+
+void DeviceManager::saveDeviceState()
+{
+    if (!hasConnectedDevice()) {
+        return;
+    }
+    const QString serial = connectedDevice();
+    const QString path = deviceStatePath(serial);
+
+    // Right after switching devices everything shown still belongs to the previous one
+    if (app_list_serial_ != serial) {
+        return;
+    }
+
+    QList<GameInfo> installed_apps;
+    for (size_t i = 0; i < app_list_model_.size(); ++i) {
+        installed_apps.append(app_list_model_[i]);
+    }
+
+    QJsonArray users;
+    for (const auto &user : users_list_) {
+        QJsonObject obj{{"id", user->id}, {"name", user->name}, {"running", user->running}};
+        if (user_packages_serial_ == serial && user_packages_.contains(user->id)) {
+            obj["packages"] = appsToJson(user_packages_[user->id]);
+        }
+        users.append(obj);
+    }
+
+    QJsonObject state{{"device_name", device_name_},
+                      {"oculus_os_version", oculus_os_version_},
+                      {"oculus_version", oculus_version_},
+                      {"oculus_runtime_version", oculus_runtime_version_},
+                      {"android_version", android_version_},
+                      {"android_sdk_version", android_sdk_version_},
+                      {"total_space", total_space_},
+                      {"free_space", free_space_},
+                      {"packages", appsToJson(installed_apps)},
+                      {"users", users},
+                      {"selected_user", selected_user_ ? selected_user_->id : -1}};
+
+    QDir().mkpath(QFileInfo(path).path());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to save state of device" << serial;
+        return;
+    }
+    file.write(QJsonDocument(state).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qWarning() << "Failed to save state of device" << serial << file.errorString();
+    }
+}
+
 QCoro::Task<void> DeviceManager::updateSerials()
 {
     QProcess basic_process;
@@ -124,6 +329,7 @@ QCoro::Task<void> DeviceManager::updateSerials()
 
     if (serials.isEmpty()) {
         disconnectDevice();
+        install_capabilities_.clear();
         if (!devices_list_.isEmpty()) {
             devices_list_.clear();
             emit devicesListChanged();
@@ -136,6 +342,11 @@ QCoro::Task<void> DeviceManager::updateSerials()
     }
 
     devices_list_ = serials;
+    for (const QString &serial : install_capabilities_.keys()) {
+        if (!devices_list_.contains(serial)) {
+            install_capabilities_.remove(serial);
+        }
+    }
     if (!devices_list_.contains(connectedDevice())) {
         disconnectDevice();
     }
@@ -507,8 +718,7 @@ QCoro::Task<void> DeviceManager::updateAndroidSdkVersion()
 QCoro::Task<void> DeviceManager::updateAppList()
 {
     if (!hasConnectedDevice()) {
-        app_list_model_.clear();
-        emit appListChanged();
+        setAppList({}, {});
         co_return;
     }
     auto serial = connectedDevice();
@@ -533,21 +743,49 @@ QCoro::Task<void> DeviceManager::updateAppList()
     lines.removeAll("");
     QRegularExpression re("package:(\\S+) versionCode:(\\d+)");
 
-    app_list_model_.clear();
+    QList<GameInfo> apps;
     for (const QString &line : lines) {
         auto match = re.match(line);
         if (match.hasMatch()) {
             QString package_name = match.captured(1);
             QString version_code = match.captured(2);
-            auto app = GameInfo{.package_name = package_name, .version_code = version_code};
-
-            app_list_model_.append(app);
+            GameInfo app{.package_name = package_name, .version_code = version_code};
+            app.intern();
+            apps.append(app);
         }
     }
-    emit appListChanged();
+    setAppList(serial, apps);
     co_return;
 }
 
+void DeviceManager::setAppList(const QString &serial, const QList<GameInfo> &apps)
+{
+    QStringList changed_packages = app_list_model_.syncByPackageName(apps);
+    installed_versions_.clear();
+    for (const auto &app : apps) {
+        installed_versions_.insert(app.package_name, app.version_code);
+    }
+
+    // A different device also changes what is installable, even when it has the same apps
+    if (!changed_packages.isEmpty() || serial != app_list_serial_) {
+        app_list_serial_ = serial;
+        emit appListChanged(changed_packages);
+    }
+}
+
+// Stop or continue a child process, used for flow control of processes whose output QProcess buffers without limit
+static void setProcessPaused(QProcess &process, bool paused)
+{
+#ifdef Q_OS_UNIX
+    if (process.processId() > 0) {
+        ::kill(process.processId(), paused ? SIGSTOP : SIGCONT);
+    }
+#else
+    Q_UNUSED(process);
+    Q_UNUSED(paused);
+#endif
+}
+
 bool replaceInFile(const QString &file_path, const QString &old_text, const QString &new_text)
 {
     QFile file(file_path);
@@ -571,13 +809,53 @@ bool replaceInFile(const QString &file_path, const QString &old_text, const QStr
     return true;
 }
 
-QCoro::Task<bool> DeviceManager::renameApk(const QFileInfo apk_file, const QString package_name, const QString new_package_name)
+QCoro::Task<QString> DeviceManager::renameApk(const QFileInfo apk_file, const QString package_name, const QString new_package_name)
 {
     if (!apk_file.exists()) {
         qWarning() << apk_file << "does not exist";
-        co_return false;
+        co_return {};
+    }
+
+    // Reinstalling the same game (to another headset, after a wipe...) reuses the renamed apk
+    const QString key_path = AppSettings::instance()->keyStorePath();
+    const QString cache_key = co_await renamed_apk_cache_.key(apk_file.absoluteFilePath(), new_package_name, key_path);
+    if (!cache_key.isEmpty()) {
+        QString cached_apk = renamed_apk_cache_.lookup(cache_key, new_package_name);
+        if (!cached_apk.isEmpty()) {
+            qDebug() << "Using cached renamed apk" << cached_apk;
+            co_return cached_apk;
+        }
+    }
+
+    const QString temp_dir = apk_file.absolutePath() + "/.temp/";
+    const QString new_apk_file = temp_dir + new_package_name + ".apk";
+    QDir().mkpath(temp_dir);
+
+    // Patch the binary manifest in a single pass over the apk, decoding and rebuilding it with apktool takes minutes for big games
+    bool renamed = false;
+    co_await runInWorkerThread([&]() {
+        renamed = ApkRenamer::rename(apk_file.absoluteFilePath(), new_apk_file, package_name, new_package_name);
+    });
+
+    if (!renamed) {
+        qWarning() << "Failed to rename" << apk_file << "in place, falling back to apktool";
+        if (!co_await rebuildApk(apk_file, package_name, new_package_name)) {
+            co_return {};
+        }
+    }
+
+    if (!co_await signApk(new_apk_file)) {
+        co_return {};
+    }
+
+    if (cache_key.isEmpty()) {
+        co_return new_apk_file;
     }
+    co_return renamed_apk_cache_.insert(cache_key, new_package_name, new_apk_file);
+}
 
+QCoro::Task<bool> DeviceManager::rebuildApk(const QFileInfo apk_file, const QString package_name, const QString new_package_name)
+{
     QProcess basic_process;
     auto adb = qCoro(basic_process);
 
@@ -585,7 +863,7 @@ QCoro::Task<bool> DeviceManager::renameApk(const QFileInfo apk_file, const QStri
     const QString temp_dir = apk_file.absolutePath() + "/.temp/";
     const QString extra_dir = temp_dir + package_name;
     adb.start(APKTOOL, {"d", "-f", apk_file.absoluteFilePath(), "-o", extra_dir});
-    co_await adb.waitForFinished(-1);
+    co_await ProcessWatchdog::waitForFinished(basic_process);
 
     if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
         qWarning() << "Failed to decode" << apk_file;
@@ -620,7 +898,7 @@ QCoro::Task<bool> DeviceManager::renameApk(const QFileInfo apk_file, const QStri
     // repack the apk
     const QString unsigned_apk_file = temp_dir + new_package_name + "-unsigned.apk";
     adb.start(APKTOOL, {"b", "-o", unsigned_apk_file, extra_dir});
-    co_await adb.waitForFinished(-1);
+    co_await ProcessWatchdog::waitForFinished(basic_process);
     if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
         qWarning() << "Failed to recompile" << apk_file;
         qWarning() << basic_process.readAllStandardError();
@@ -630,14 +908,21 @@ QCoro::Task<bool> DeviceManager::renameApk(const QFileInfo apk_file, const QStri
     // 4k align the apk
     const QString new_apk_file = temp_dir + new_package_name + ".apk";
     adb.start(ZIPALIGN, {"-f", "-v", "4", unsigned_apk_file, new_apk_file});
-    co_await adb.waitForFinished(-1);
+    co_await ProcessWatchdog::waitForFinished(basic_process);
     if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
         qWarning() << "Failed to align" << unsigned_apk_file;
         qWarning() << basic_process.readAllStandardError();
         co_return false;
     }
 
-    // sign the apk
+    co_return true;
+}
+
+QCoro::Task<bool> DeviceManager::signApk(const QString new_apk_file)
+{
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+
     QString key_path = AppSettings::instance()->keyStorePath();
     if (key_path.isEmpty()) {
         qWarning() << "Failed to locate qrookie.keystore";
@@ -645,7 +930,7 @@ QCoro::Task<bool> DeviceManager::renameApk(const QFileInfo apk_file, const QStri
     }
     adb.start(APKSIGNER, {"sign", "--ks", key_path, "--ks-key-alias", "qrookie", "--ks-pass", "pass:qrookie", "--key-pass", "pass:qrookie", new_apk_file});
 
-    co_await adb.waitForFinished(-1);
+    co_await ProcessWatchdog::waitForFinished(basic_process);
     if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
         qWarning() << "Failed to sign" << new_apk_file;
         qWarning() << basic_process.readAllStandardError();
@@ -662,217 +947,1038 @@ QCoro::Task<bool> DeviceManager::installApk(const QString path, const QString pa
     }
     auto serial = connectedDevice();
 
-    QDir apk_dir(path);
+    auto job = QSharedPointer<InstallJob>::create();
+    job->serial = serial;
+    job->path = path;
+    job->package_name = package_name;
+    job->new_package_name = rename_package ? package_name + ".qrookie" : package_name;
+    job->rename_package = rename_package;
+    co_return co_await enqueueInstall(job);
+}
 
-    if (!apk_dir.exists()) {
-        qWarning() << path << " does not exist";
+QCoro::Task<bool> DeviceManager::installApkFromArchive(const QString archive_path, const QString password, const QString package_name)
+{
+    if (!hasConnectedDevice() || !archiveInstallSupported()) {
         co_return false;
     }
 
-    QStringList apk_files = apk_dir.entryList(QStringList() << "*.apk", QDir::Files);
+    auto job = QSharedPointer<InstallJob>::create();
+    job->serial = connectedDevice();
+    job->package_name = package_name;
+    job->new_package_name = package_name;
+    job->archive_path = archive_path;
+    job->archive_password = password;
+    co_return co_await enqueueInstall(job);
+}
 
-    if (apk_files.isEmpty()) {
-        qWarning() << "No apk file found in" << path;
-        co_return false;
-    }
+QCoro::Task<bool> DeviceManager::enqueueInstall(QSharedPointer<InstallJob> job)
+{
+    const QString serial = job->serial;
 
-    QString new_package_name;
-    if (rename_package) {
-        new_package_name = package_name + ".qrookie";
-        QFileInfo apk_file(path + "/" + package_name + ".apk");
-        if (!co_await renameApk(apk_file, package_name, new_package_name)) {
-            qWarning() << "Failed to rename package name for" << apk_file;
-            co_return false;
-        }
+    // Fail now rather than after hours of transfer when the headset can't fit this job next to the ones queued before it
+    if (!co_await admitInstall(job)) {
+        emit installStateChanged(serial, job->package_name, InstallState::Failed);
+        co_return false;
     }
 
-    QProcess basic_process;
-    auto adb = qCoro(basic_process);
-    for (const QString &apk_file : apk_files) {
-        QString apk_path;
+    job->id = ++last_install_job_id_;
+    install_queues_[serial].append(job);
+    emit installStateChanged(serial, job->package_name, InstallState::Queued);
 
-        if (rename_package && apk_file == package_name + ".apk") {
-            apk_path = path + "/.temp/" + new_package_name + ".apk";
-        } else {
-            apk_path = path + "/" + apk_file;
-        }
+    const auto &queue = install_queues_[serial];
+    if (queue.size() == 1) {
+        runInstallQueue(serial);
+    } else if (queue.size() == 2 && queue.first()->installing) {
+        // The device is busy with the package manager, stage this one in the meantime
+        startStaging(job);
+    }
 
-        qDebug() << "Installing" << apk_path << "on device" << serial;
-        adb.start(ADB, {"-s", serial, "install", "-r", apk_path});
-        co_await adb.waitForFinished(-1);
+    while (!job->finished) {
+        co_await qCoro(this, &DeviceManager::installJobFinished);
+    }
+    co_return job->result;
+}
 
-        if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
-            QString err_msg = basic_process.readAllStandardError();
-
-            // if the signatures do not match previously installed version, try to uninstall the app first
-            if (err_msg.contains("signatures do not match previously installed version")) {
-                QString pkg_name = rename_package ? new_package_name : package_name;
-                qWarning() << "Signatures do not match previously installed version, try uninstall the app first";
-                qWarning() << "Uninstalling" << pkg_name << "on device" << serial;
-                if (co_await uninstallApk(pkg_name, false)) {
-                    qDebug() << "Reinstalling" << apk_path << "on device" << serial;
-                    adb.start(ADB, {"-s", serial, "install", "-r", apk_path});
-                    co_await adb.waitForFinished(-1);
-                    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
-                        qWarning() << "Failed to reinstall" << apk_path << "on device" << serial;
-                        qWarning() << basic_process.readAllStandardError();
-                        co_return false;
-                    }
-                }
-            } else {
-                qWarning() << "Failed to install" << apk_path << "on device" << serial;
-                qWarning() << err_msg;
-                co_return false;
-            }
-        }
+static qint64 dirSize(const QString &path)
+{
+    qint64 size = 0;
+    QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        size += it.fileInfo().size();
     }
+    return size;
+}
 
-    QString obb_path = path + "/" + package_name;
-    QDir obb_dir(obb_path);
-    QString pkg_name = rename_package ? new_package_name : package_name;
-    if (!package_name.isEmpty() && obb_dir.exists()) {
-        qDebug() << "Pushing obb file for" << pkg_name << "to device" << serial;
-        adb.start(ADB, {"-s", serial, "shell", "rm", "-rf", "/sdcard/Android/obb/" + pkg_name});
-        co_await adb.waitForFinished(-1);
-        adb.start(ADB, {"-s", serial, "shell", "mkdir", "/sdcard/Android/obb/" + pkg_name});
-        co_await adb.waitForFinished(-1);
-
-        QStringList obb_files = obb_dir.entryList(QStringList() << "*", QDir::Files);
-        for (const QString &obb_file : obb_files) {
-            qDebug() << "Pushing" << obb_file << "to device" << serial;
-            QString src = obb_path + "/" + obb_file;
-            QString dst_file_name = obb_file;
-            if (rename_package)
-                dst_file_name.replace(package_name, pkg_name);
-            QString dst = "/sdcard/Android/obb/" + pkg_name + "/" + dst_file_name;
-
-            adb.start(ADB, {"-s", serial, "push", src, dst});
-            co_await adb.waitForFinished(-1);
-            if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
-                qWarning() << "Failed to push obb file for" << pkg_name << "on device" << serial;
-                qWarning() << basic_process.readAllStandardError();
-                co_return false;
+QCoro::Task<bool> DeviceManager::admitInstall(QSharedPointer<InstallJob> job)
+{
+    if (!job->archive_path.isEmpty()) {
+        job->install_size = SevenZip::unpackedSize(co_await SevenZip::list(job->archive_path, job->archive_password));
+    } else {
+        // Measured off the gui thread like the space reservations, a game directory can hold many files
+        co_await runInWorkerThread([job]() {
+            job->install_size = 0;
+            for (const QFileInfo &apk : QDir(job->path).entryInfoList({"*.apk"}, QDir::Files)) {
+                job->install_size += apk.size();
             }
-        }
+            if (!job->package_name.isEmpty()) {
+                job->install_size += dirSize(job->path + "/" + job->package_name);
+            }
+        });
     }
 
-    // https://vrpirates.wiki/en/Howto/Manual-Sideloading
-    // Some applications have an install.txt file that needs to be executed.
-    // Arbitrary support for install.txt has potential security issues and is only adapted for specific applications
+    co_return co_await hasDeviceSpace(job->serial, job->new_package_name, job->install_size);
+}
 
-    if (package_name == QStringLiteral("tdg.oculuswirelessadb")) {
-        adb.start(ADB, {"-s", serial, "shell", "pm", "grant", pkg_name, "android.permission.WRITE_SECURE_SETTINGS"});
-        co_await adb.waitForFinished();
-        adb.start(ADB, {"-s", serial, "shell", "pm", "grant", pkg_name, "android.permission.READ_LOGS"});
-        co_await adb.waitForFinished();
+QCoro::Task<bool> DeviceManager::hasDeviceSpace(const QString serial, const QString package_name, qint64 bytes)
+{
+    const qint64 free_space = co_await deviceFreeSpace(serial, package_name);
+    if (free_space < 0) {
+        // Unknown, let the install find out by itself
+        co_return true;
     }
 
-    updateDeviceInfo();
+    // Jobs that started transferring already show up in the free space
+    qint64 reserved = 0;
+    for (const auto &queued : install_queues_.value(serial)) {
+        if (!queued->installing && !queued->staging) {
+            reserved += queued->install_size;
+        }
+    }
 
+    if (bytes + reserved + DEVICE_SPACE_MARGIN > free_space) {
+        qWarning() << "Not enough space on device" << serial << "for" << package_name << ", need" << bytes << "bytes," << reserved
+                   << "reserved by queued installs, have" << free_space;
+        co_return false;
+    }
     co_return true;
 }
 
-QCoro::Task<bool> DeviceManager::uninstallApk(const QString package_name, bool update_device_info)
+QCoro::Task<qint64> DeviceManager::deviceFreeSpace(const QString serial, const QString package_name)
 {
-    if (!hasConnectedDevice()) {
-        co_return false;
-    }
-
-    auto serial = connectedDevice();
-
+    // The obb files of a previous version are deleted before the new ones are pushed
     QProcess basic_process;
     auto adb = qCoro(basic_process);
-    adb.start(ADB, {"-s", serial, "uninstall", package_name});
-    co_await adb.waitForFinished(-1);
+    adb.start(ADB, {"-s", serial, "shell", QString("df /sdcard; du -sk '/sdcard/Android/obb/%1' 2>/dev/null").arg(package_name)});
+    co_await adb.waitForFinished();
 
-    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
-        qWarning() << "Failed to uninstall" << package_name << "on device" << serial;
-        qWarning() << basic_process.readAllStandardError();
-        co_return false;
+    if (basic_process.exitStatus() != QProcess::NormalExit) {
+        qWarning() << "Failed to get free space for device" << serial;
+        co_return -1;
     }
 
-    if (update_device_info) {
-        updateDeviceInfo();
+    /* EXAMPLE OUTPUT:
+        Filesystem     1K-blocks     Used Available Use% Mounted on
+        /dev/fuse      107584204 83476996  23959752  78% /storage/emulated
+        2622516	/sdcard/Android/obb/com.beatgames.beatsaber
+    */
+    QStringList lines = QString(basic_process.readAllStandardOutput()).split("\n", Qt::SkipEmptyParts);
+    if (lines.size() < 2) {
+        qWarning() << "Failed to get free space for device" << serial;
+        co_return -1;
     }
-    co_return true;
+
+    QStringList parts = lines[1].split(QRegularExpression("\\s+"));
+    if (parts.size() < 4) {
+        qWarning() << "Failed to get free space for device" << serial;
+        co_return -1;
+    }
+    qint64 free_space = parts[3].toLongLong();
+    if (lines.size() > 2) {
+        free_space += lines[2].split(QRegularExpression("\\s+")).first().toLongLong();
+    }
+    co_return free_space * 1024;
 }
 
-QCoro::Task<bool> DeviceManager::connectToWirelessDevice(const QString address /*host:port*/)
+QCoro::Task<void> DeviceManager::runInstallQueue(const QString serial)
 {
-    if (address.isEmpty()) {
-        qWarning() << "Empty address";
-        co_return false;
+    // One pm install at a time per device
+    while (!install_queues_.value(serial).isEmpty()) {
+        auto job = install_queues_[serial].first();
+        bool result;
+
+        if (!job->archive_path.isEmpty()) {
+            // Nothing is extracted on the host, the archive is streamed to the device
+            job->installing = true;
+            emit installStateChanged(serial, job->package_name, InstallState::Installing);
+            result = co_await streamArchiveInstall(job);
+            startStagingNext(serial);
+
+            if (result) {
+                co_await grantPermissions(serial, job->package_name, job->new_package_name);
+            }
+        } else if (job->staging) {
+            // Staged while the previous title was installing
+            result = co_await *job->staging;
+            job->staging.reset();
+
+            if (result) {
+                job->installing = true;
+                startStagingNext(serial);
+                emit installStateChanged(serial, job->package_name, InstallState::Installing);
+                result = co_await installStagedApks(serial, job->local_apks.first(), job->staged_apks, job->package_name, job->new_package_name);
+            } else if (!job->staged_apks.isEmpty()) {
+                co_await runAdbCommand(serial, {"shell", "rm", "-rf", QFileInfo(job->staged_apks.first()).path()});
+            }
+        } else {
+            // Nothing staged yet, stream the apks straight into the package manager
+            job->installing = true;
+            emit installStateChanged(serial, job->package_name, InstallState::Installing);
+            result = co_await prepareInstallJob(job);
+            if (result) {
+                for (const QString &apk_path : job->local_apks) {
+                    if (!co_await streamInstall(serial, apk_path, job->new_package_name)) {
+                        result = false;
+                        break;
+                    }
+                }
+            }
+            // The streamed install is the transfer, staging the next title alongside would halve its bandwidth
+            startStagingNext(serial);
+
+            if (result) {
+                co_await grantPermissions(serial, job->package_name, job->new_package_name);
+            }
+        }
+
+        QString obb_path = job->path + "/" + job->package_name;
+        if (result && job->archive_path.isEmpty() && !job->package_name.isEmpty() && QDir(obb_path).exists()) {
+            result = co_await pushObb(serial, obb_path, job->package_name, job->new_package_name);
+        }
+
+        job->result = result;
+        job->finished = true;
+        install_queues_[serial].removeFirst();
+        emit installStateChanged(serial, job->package_name, result ? InstallState::Installed : InstallState::Failed);
+        emit installJobFinished(job->id);
+
+        if (serial == connectedDevice()) {
+            updateDeviceInfo();
+        }
     }
+    install_queues_.remove(serial);
+}
 
-    QProcess basic_process;
-    auto adb = qCoro(basic_process);
-    adb.start(ADB, {"connect", address});
-    co_await adb.waitForFinished();
+void DeviceManager::startStaging(QSharedPointer<InstallJob> job)
+{
+    // Archive installs stream straight to the device when their turn comes
+    if (!job->staging && job->archive_path.isEmpty()) {
+        job->staging = QSharedPointer<QCoro::Task<bool>>::create(stageInstallJob(job));
+    }
+}
 
-    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
-        qWarning() << "Failed to connect to" << address;
-        qWarning() << basic_process.readAllStandardError();
+void DeviceManager::startStagingNext(const QString &serial)
+{
+    // Pre-stage the next title while the package manager is busy with the current one
+    const auto &queue = install_queues_[serial];
+    if (queue.size() > 1) {
+        startStaging(queue[1]);
+    }
+}
 
+QCoro::Task<bool> DeviceManager::prepareInstallJob(QSharedPointer<InstallJob> job)
+{
+    QDir apk_dir(job->path);
+    if (!apk_dir.exists()) {
+        qWarning() << job->path << " does not exist";
         co_return false;
     }
 
-    auto output = basic_process.readAllStandardOutput();
-
-    if (!output.startsWith("connected to " + address.toLocal8Bit()) && !output.contains("already connected to " + address.toLocal8Bit())) {
-        qWarning() << output;
+    QStringList apk_files = apk_dir.entryList(QStringList() << "*.apk", QDir::Files);
+    if (apk_files.isEmpty()) {
+        qWarning() << "No apk file found in" << job->path;
         co_return false;
     }
 
-    co_await updateSerials();
-    connectToDevice(address);
+    QString renamed_apk;
+    if (job->rename_package) {
+        QFileInfo apk_file(job->path + "/" + job->package_name + ".apk");
+        renamed_apk = co_await renameApk(apk_file, job->package_name, job->new_package_name);
+        if (renamed_apk.isEmpty()) {
+            qWarning() << "Failed to rename package name for" << apk_file;
+            co_return false;
+        }
+    }
+
+    job->local_apks.clear();
+    for (const QString &apk_file : apk_files) {
+        if (job->rename_package && apk_file == job->package_name + ".apk") {
+            job->local_apks.append(renamed_apk);
+        } else {
+            job->local_apks.append(job->path + "/" + apk_file);
+        }
+    }
     co_return true;
 }
 
-QCoro::Task<bool> DeviceManager::enableTcpMode(int port)
+QCoro::Task<bool> DeviceManager::stageInstallJob(QSharedPointer<InstallJob> job)
 {
-    if (!hasConnectedDevice()) {
+    emit installStateChanged(job->serial, job->package_name, InstallState::Staging);
+
+    if (!co_await prepareInstallJob(job)) {
         co_return false;
     }
 
-    if (port < 1024 || port > 65535) {
-        qWarning() << "Invalid port" << port;
-        co_return false;
+    const QString staging_dir = DEVICE_STAGING_DIR + "/" + QString::number(job->id);
+    QList<QPair<QString, QString>> files;
+    for (const QString &apk_path : job->local_apks) {
+        QString remote_apk = staging_dir + "/" + QFileInfo(apk_path).fileName();
+        files.append({apk_path, remote_apk});
+        job->staged_apks.append(remote_apk);
     }
 
-    auto serial = connectedDevice();
+    qDebug() << "Staging" << job->package_name << "on device" << job->serial;
+    AdbSync sync(job->serial);
+    connect(&sync, &AdbSync::progress, this, [this, job](qint64 bytes_sent, qint64 bytes_total, double bytes_per_second) {
+        emit pushProgressChanged(job->serial, job->package_name, bytes_sent, bytes_total, bytes_per_second);
+    });
+
+    if (co_await sync.push(files)) {
+        co_return true;
+    }
 
+    // Fall back to one adb push per file, e.g. when the adb server is not reachable over tcp
+    qWarning() << "Sync push failed, falling back to adb push:" << sync.errorString();
     QProcess basic_process;
     auto adb = qCoro(basic_process);
-    adb.start(ADB, {"-s", serial, "tcpip", QString::number(port)});
-    co_await adb.waitForFinished(5000);
-
-    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
-        qWarning() << "Failed to enable tcp mode on device" << serial;
-        qWarning() << basic_process.readAllStandardError();
-        co_return false;
+    for (const auto &[src, dst] : files) {
+        qDebug() << "Pushing" << src << "to device" << job->serial;
+        adb.start(ADB, {"-s", job->serial, "push", src, dst});
+        co_await ProcessWatchdog::waitForFinished(basic_process, pushStallTimeout());
+        if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
+            qWarning() << "Failed to stage" << job->package_name << "on device" << job->serial;
+            qWarning() << basic_process.readAllStandardError();
+            co_return false;
+        }
     }
-
-    qDebug() << basic_process.readAllStandardOutput();
-
     co_return true;
 }
 
-QCoro::Task<void> DeviceManager::updateUsers()
+QCoro::Task<bool> DeviceManager::streamArchiveInstall(QSharedPointer<InstallJob> job)
 {
-    users_list_.clear();
-    if (!hasConnectedDevice()) {
-        emit usersListChanged();
-        co_return;
+    const QString serial = job->serial;
+    const InstallCapabilities capabilities = co_await installCapabilities(serial);
+    if (!capabilities.streaming) {
+        qWarning() << "Device" << serial << "does not support streamed installs";
+        co_return false;
     }
 
-    auto serial = connectedDevice();
+    // Work out where every file of the archive goes, archive layout is <release name>/<package>.apk and <release name>/<package>/*.obb
+    enum Target { Discard, Apk, Obb };
+    QList<ArchiveEntry> files;
+    QList<Target> targets;
+    qint64 bytes_total = 0;
+    bool has_obb = false;
+    for (const auto &entry : co_await SevenZip::list(job->archive_path, job->archive_password)) {
+        if (entry.is_dir) {
+            continue;
+        }
 
-    QProcess basic_process;
-    auto adb = qCoro(basic_process);
-    adb.start(ADB, {"-s", serial, "shell", "pm", "list", "users"});
+        QStringList parts = QString(entry.path).replace('\\', '/').split('/');
+        Target target = Discard;
+        if (parts.size() == 2 && parts[1].endsWith(".apk", Qt::CaseInsensitive)) {
+            target = Apk;
+        } else if (parts.size() == 3 && parts[1] == job->package_name) {
+            target = Obb;
+            has_obb = true;
+        }
 
-    co_await adb.waitForFinished();
+        files.append(entry);
+        targets.append(target);
+        if (target != Discard) {
+            bytes_total += entry.size;
+        }
+    }
+
+    if (!targets.contains(Apk)) {
+        qWarning() << "No apk file found in" << job->archive_path;
+        co_return false;
+    }
+
+    const QString obb_dst_dir = "/sdcard/Android/obb/" + job->new_package_name;
+    AdbSync sync(serial);
+    if (has_obb) {
+        co_await runAdbCommand(serial, {"shell", "rm", "-rf", obb_dst_dir});
+        if (!co_await sync.open()) {
+            co_return false;
+        }
+    }
+
+    QProcess basic_process;
+    auto p7za = qCoro(basic_process);
+    SevenZip::startExtractToStdout(basic_process, job->archive_path, job->archive_password);
+    ProcessWatchdog p7za_watchdog(&basic_process);
+    bool paused = false;
+
+    // A stalled process is killed, which ends the loops below like any other failure
+    QProcess install_process;
+    auto installer = qCoro(install_process);
+    ProcessWatchdog installer_watchdog(&install_process, installStallTimeout());
+
+    qint64 bytes_done = 0;
+    QElapsedTimer elapsed_timer;
+    QElapsedTimer progress_timer;
+    elapsed_timer.start();
+    progress_timer.start();
+
+    bool result = true;
+    for (int i = 0; i < files.size() && result; ++i) {
+        const ArchiveEntry &file = files[i];
+        const Target target = targets[i];
+
+        if (target == Apk) {
+            qDebug() << "Streaming" << file.path << "to device" << serial;
+            install_process.start(ADB, {"-s", serial, "exec-in", "cmd", "package", "install", "-r", "-S", QString::number(file.size)});
+            result = co_await installer.waitForStarted();
+        } else if (target == Obb) {
+            qDebug() << "Streaming" << file.path << "to device" << serial;
+            result = co_await sync.beginFile(obb_dst_dir + "/" + QFileInfo(file.path).fileName());
+        }
+
+        qint64 remaining = file.size;
+        while (result && remaining > 0) {
+            // The package manager gave up, the rest of the apk isn't needed
+            if (target == Apk && install_process.state() == QProcess::NotRunning) {
+                qWarning() << "Install of" << file.path << "ended before the whole apk was sent";
+                result = false;
+                break;
+            }
+
+            if (basic_process.bytesAvailable() == 0) {
+                if (paused) {
+                    setProcessPaused(basic_process, paused = false);
+                }
+
+                if (!co_await p7za.waitForReadyRead(30000) && basic_process.state() == QProcess::NotRunning && basic_process.bytesAvailable() == 0) {
+                    qWarning() << "7za stopped before the end of" << file.path;
+                    result = false;
+                }
+                continue;
+            }
+
+            QByteArray data = basic_process.read(qMin<qint64>(remaining, 1024 * 1024));
+            remaining -= data.size();
+            p7za_watchdog.reportProgress();
+
+            // QProcess buffers everything 7za writes, pause it while the device can't keep up
+            if (!paused && basic_process.bytesAvailable() > 64 * 1024 * 1024) {
+                setProcessPaused(basic_process, paused = true);
+            } else if (paused && basic_process.bytesAvailable() < 16 * 1024 * 1024) {
+                setProcessPaused(basic_process, paused = false);
+            }
+
+            if (target == Apk) {
+                install_process.write(data);
+                while (install_process.bytesToWrite() > 4 * 1024 * 1024 && install_process.state() == QProcess::Running) {
+                    co_await installer.waitForBytesWritten(30000);
+                }
+            } else if (target == Obb) {
+                result = co_await sync.writeData(data);
+            }
+
+            if (target != Discard) {
+                bytes_done += data.size();
+                if (progress_timer.elapsed() >= 200 || bytes_done == bytes_total) {
+                    double seconds = elapsed_timer.elapsed() / 1000.0;
+                    emit pushProgressChanged(serial, job->package_name, bytes_done, bytes_total, seconds > 0 ? bytes_done / seconds : 0.0);
+                    progress_timer.restart();
+                }
+            }
+        }
+
+        if (target == Apk) {
+            install_process.closeWriteChannel();
+            co_await installer.waitForFinished(-1);
+            QString output = QString(install_process.readAllStandardOutput()) + install_process.readAllStandardError();
+            if (!result || install_process.exitStatus() != QProcess::NormalExit || install_process.exitCode() != 0 || !output.contains("Success")) {
+                qWarning() << "Failed to install" << file.path << "on device" << serial;
+                qWarning() << output;
+                result = false;
+            }
+        } else if (target == Obb && result) {
+            result = co_await sync.endFile();
+        }
+    }
+
+    if (has_obb && !co_await sync.close()) {
+        result = false;
+    }
+
+    if (paused) {
+        setProcessPaused(basic_process, false);
+    }
+    if (!result) {
+        basic_process.kill();
+    }
+    co_await p7za.waitForFinished(-1);
+
+    if (result && (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0)) {
+        qWarning("Error: %s", basic_process.readAllStandardError().data());
+        result = false;
+    }
+    co_return result;
+}
+
+QCoro::Task<DeviceManager::InstallCapabilities> DeviceManager::installCapabilities(const QString serial)
+{
+    if (install_capabilities_.contains(serial)) {
+        co_return install_capabilities_.value(serial);
+    }
+
+    InstallCapabilities capabilities;
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+
+    /* EXAMPLE OUTPUT:
+        shell_v2
+        cmd
+        stat_v2
+        abb_exec
+        ...
+    */
+    adb.start(ADB, {"-s", serial, "features"});
+    co_await adb.waitForFinished();
+    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
+        qWarning() << "Failed to get features for device" << serial;
+        co_return capabilities;
+    }
+    QStringList features = QString(basic_process.readAllStandardOutput()).split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts);
+    capabilities.streaming = features.contains("cmd") || features.contains("abb_exec");
+
+    // Incremental installs also need incfs support in the kernel and the package manager
+    if (features.contains("abb_exec")) {
+        adb.start(ADB, {"-s", serial, "shell", "getprop", "ro.incremental.enable"});
+        co_await adb.waitForFinished();
+        QString output = QString(basic_process.readAllStandardOutput()).trimmed();
+        capabilities.incremental = !output.isEmpty() && output != "0" && output != "false";
+    }
+
+    qDebug() << "Device" << serial << "streaming install:" << capabilities.streaming << "incremental install:" << capabilities.incremental;
+    install_capabilities_[serial] = capabilities;
+    co_return capabilities;
+}
+
+QCoro::Task<bool> DeviceManager::streamInstall(const QString serial, const QString apk_path, const QString package_name)
+{
+    const InstallCapabilities capabilities = co_await installCapabilities(serial);
+
+    // Try the fastest install mode first and fall back if the device or adb rejects it
+    QStringList modes;
+    if (capabilities.incremental && QFile::exists(apk_path + ".idsig")) {
+        modes << "--incremental";
+    }
+    if (capabilities.streaming) {
+        modes << "--streaming" << "--no-streaming";
+    } else {
+        modes << QString();
+    }
+
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+    bool uninstalled = false;
+    for (int i = 0; i < modes.size(); ++i) {
+        const QString &mode = modes[i];
+        qDebug() << "Installing" << apk_path << "on device" << serial << "with" << mode;
+        QStringList args = {"-s", serial, "install", "-r"};
+        if (!mode.isEmpty()) {
+            args << mode;
+        }
+        adb.start(ADB, args << apk_path);
+        co_await ProcessWatchdog::waitForFinished(basic_process, installStallTimeout());
+        QString output = QString(basic_process.readAllStandardOutput()) + basic_process.readAllStandardError();
+
+        if (basic_process.exitStatus() == QProcess::NormalExit && basic_process.exitCode() == 0) {
+            co_return true;
+        }
+
+        // if the signatures do not match previously installed version, try to uninstall the app first
+        if (!uninstalled && output.contains("signatures do not match")) {
+            qWarning() << "Signatures do not match previously installed version, try uninstall the app first";
+            qWarning() << "Uninstalling" << package_name << "on device" << serial;
+            uninstalled = true;
+            if (co_await runAdbCommand(serial, {"uninstall", package_name})) {
+                --i;
+                continue;
+            }
+        }
+
+        // The package manager rejected the apk itself, another install mode won't help
+        if (output.contains("INSTALL_FAILED") || output.contains("INSTALL_PARSE_FAILED")) {
+            qWarning() << "Failed to install" << apk_path << "on device" << serial;
+            qWarning() << output;
+            co_return false;
+        }
+
+        qWarning() << "Install with" << mode << "failed for" << apk_path << "on device" << serial;
+        qWarning() << output;
+    }
+    co_return false;
+}
+
+QCoro::Task<void> DeviceManager::grantPermissions(const QString serial, const QString package_name, const QString new_package_name)
+{
+    // https://vrpirates.wiki/en/Howto/Manual-Sideloading
+    // Some applications have an install.txt file that needs to be executed.
+    // Arbitrary support for install.txt has potential security issues and is only adapted for specific applications
+    if (package_name == QStringLiteral("tdg.oculuswirelessadb")) {
+        co_await runAdbCommand(serial, {"shell", "pm", "grant", new_package_name, "android.permission.WRITE_SECURE_SETTINGS"});
+        co_await runAdbCommand(serial, {"shell", "pm", "grant", new_package_name, "android.permission.READ_LOGS"});
+    }
+}
+
+QCoro::Task<QVariantMap> DeviceManager::installApkToDevices(const QStringList serials, const QString path, const QString package_name, bool rename_package)
+{
+    QVariantMap results;
+    QStringList targets;
+    for (const QString &serial : serials) {
+        if (devices_list_.contains(serial)) {
+            if (!targets.contains(serial)) {
+                targets.append(serial);
+            }
+        } else {
+            qWarning() << "Device not found" << serial;
+            results[serial] = false;
+        }
+    }
+
+    QDir apk_dir(path);
+    QStringList apk_files = apk_dir.entryList(QStringList() << "*.apk", QDir::Files);
+    if (apk_files.isEmpty()) {
+        qWarning() << "No apk file found in" << path;
+        targets.clear();
+    }
+
+    QString new_package_name;
+    QString renamed_apk;
+    if (!targets.isEmpty() && rename_package) {
+        new_package_name = package_name + ".qrookie";
+        QFileInfo apk_file(path + "/" + package_name + ".apk");
+        renamed_apk = co_await renameApk(apk_file, package_name, new_package_name);
+        if (renamed_apk.isEmpty()) {
+            qWarning() << "Failed to rename package name for" << apk_file;
+            targets.clear();
+        }
+    }
+
+    if (targets.isEmpty()) {
+        for (const QString &serial : serials) {
+            results[serial] = false;
+        }
+        co_return results;
+    }
+
+    // Local files and where they go on every device
+    QString pkg_name = rename_package ? new_package_name : package_name;
+    QList<QPair<QString, QString>> files;
+    QStringList staged_apks;
+    const QString staging_dir = DEVICE_STAGING_DIR + "/" + QString::number(++last_install_job_id_);
+    for (const QString &apk_file : apk_files) {
+        QString apk_path = path + "/" + apk_file;
+        if (rename_package && apk_file == package_name + ".apk") {
+            apk_path = renamed_apk;
+        }
+        QString remote_apk = staging_dir + "/" + QFileInfo(apk_path).fileName();
+        files.append({apk_path, remote_apk});
+        staged_apks.append(remote_apk);
+    }
+
+    const QString obb_path = path + "/" + package_name;
+    const QString obb_dst_dir = "/sdcard/Android/obb/" + pkg_name;
+    QDir obb_dir(obb_path);
+    bool has_obb = !package_name.isEmpty() && obb_dir.exists();
+    if (has_obb) {
+        for (const QString &obb_file : obb_dir.entryList(QStringList() << "*", QDir::Files)) {
+            QString dst_file_name = obb_file;
+            if (rename_package)
+                dst_file_name.replace(package_name, pkg_name);
+            files.append({obb_path + "/" + obb_file, obb_dst_dir + "/" + dst_file_name});
+        }
+    }
+
+    qint64 bytes_total = 0;
+    for (const auto &[local_path, remote_path] : files) {
+        bytes_total += QFileInfo(local_path).size();
+    }
+
+    for (const QString &serial : QStringList(targets)) {
+        if (!co_await hasDeviceSpace(serial, pkg_name, bytes_total)) {
+            results[serial] = false;
+            targets.removeAll(serial);
+            emit deviceInstallFinished(serial, package_name, false);
+        }
+    }
+
+    // Open one sync session per device, all devices in parallel
+    std::vector<std::unique_ptr<AdbSync>> syncs;
+    std::vector<QCoro::Task<bool>> open_tasks;
+    std::vector<bool> alive;
+    for (const QString &serial : targets) {
+        if (has_obb) {
+            co_await runAdbCommand(serial, {"shell", "rm", "-rf", obb_dst_dir});
+        }
+        syncs.push_back(std::make_unique<AdbSync>(serial));
+        open_tasks.push_back(syncs.back()->open());
+    }
+    for (size_t i = 0; i < syncs.size(); ++i) {
+        alive.push_back(co_await open_tasks[i]);
+    }
+
+    // Read every local file once and stream each chunk to all devices
+    const qint64 bandwidth_limit = qint64(AppSettings::instance()->usbBandwidthLimit()) * 1024 * 1024;
+    qint64 bytes_read = 0;
+    qint64 bytes_on_bus = 0;
+    QElapsedTimer elapsed_timer;
+    QElapsedTimer progress_timer;
+    elapsed_timer.start();
+    progress_timer.start();
+
+    for (const auto &[local_path, remote_path] : files) {
+        QFile file(local_path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Failed to open" << local_path;
+            std::fill(alive.begin(), alive.end(), false);
+            break;
+        }
+
+        for (size_t i = 0; i < syncs.size(); ++i) {
+            if (alive[i] && !co_await syncs[i]->beginFile(remote_path)) {
+                alive[i] = false;
+            }
+        }
+
+        while (!file.atEnd() && std::find(alive.begin(), alive.end(), true) != alive.end()) {
+            QByteArray data = file.read(1024 * 1024);
+            if (data.isEmpty()) {
+                qWarning() << "Failed to read" << local_path;
+                std::fill(alive.begin(), alive.end(), false);
+                break;
+            }
+            bytes_read += data.size();
+
+            for (size_t i = 0; i < syncs.size(); ++i) {
+                if (alive[i]) {
+                    alive[i] = co_await syncs[i]->writeData(data);
+                    bytes_on_bus += data.size();
+                }
+            }
+
+            // Keep the total rate of this host under the configured limit
+            if (bandwidth_limit > 0) {
+                qint64 ahead_ms = bytes_on_bus * 1000 / bandwidth_limit - elapsed_timer.elapsed();
+                if (ahead_ms > 0) {
+                    co_await QCoro::sleepFor(std::chrono::milliseconds(ahead_ms));
+                }
+            }
+
+            if (progress_timer.elapsed() >= 200 || bytes_read == bytes_total) {
+                double seconds = elapsed_timer.elapsed() / 1000.0;
+                for (size_t i = 0; i < syncs.size(); ++i) {
+                    if (alive[i]) {
+                        const qint64 bytes_sent = syncs[i]->bytesSent();
+                        emit pushProgressChanged(targets[i], package_name, bytes_sent, bytes_total, seconds > 0 ? bytes_sent / seconds : 0.0);
+                    }
+                }
+                progress_timer.restart();
+            }
+        }
+
+        for (size_t i = 0; i < syncs.size(); ++i) {
+            if (alive[i] && !co_await syncs[i]->endFile()) {
+                alive[i] = false;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < syncs.size(); ++i) {
+        if (alive[i] && !co_await syncs[i]->close()) {
+            alive[i] = false;
+        }
+    }
+
+    // Install the staged apks, all devices in parallel
+    std::vector<QCoro::Task<bool>> install_tasks;
+    for (size_t i = 0; i < syncs.size(); ++i) {
+        if (alive[i]) {
+            install_tasks.push_back(installStagedApks(targets[i], files.first().first, staged_apks, package_name, pkg_name));
+        } else {
+            qWarning() << "Failed to push" << package_name << "to device" << targets[i];
+        }
+    }
+
+    size_t task_index = 0;
+    for (size_t i = 0; i < syncs.size(); ++i) {
+        bool result = false;
+        if (alive[i]) {
+            result = co_await install_tasks[task_index++];
+        } else {
+            // Whatever made it to the device before the push failed
+            co_await runAdbCommand(targets[i], {"shell", "rm", "-rf", staging_dir});
+        }
+        results[targets[i]] = result;
+        emit deviceInstallFinished(targets[i], package_name, result);
+    }
+
+    if (targets.contains(connectedDevice())) {
+        updateDeviceInfo();
+    }
+    co_return results;
+}
+
+QCoro::Task<bool> DeviceManager::installStagedApks(const QString serial,
+                                                    const QString local_apk,
+                                                    const QStringList remote_apks,
+                                                    const QString package_name,
+                                                    const QString new_package_name)
+{
+    // Only now that the apks are on the device, a failed transfer must not cost the installed app and its data
+    co_await uninstallIfSignatureMismatch(serial, local_apk, new_package_name);
+
+    bool result = true;
+    for (const QString &remote_apk : remote_apks) {
+        if (!co_await pmInstall(serial, remote_apk, new_package_name)) {
+            result = false;
+            break;
+        }
+    }
+    if (!remote_apks.isEmpty()) {
+        co_await runAdbCommand(serial, {"shell", "rm", "-rf", QFileInfo(remote_apks.first()).path()});
+    }
+
+    if (result) {
+        co_await grantPermissions(serial, package_name, new_package_name);
+    }
+    co_return result;
+}
+
+QCoro::Task<bool> DeviceManager::pmInstall(const QString serial, const QString remote_apk, const QString package_name)
+{
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+
+    qDebug() << "Installing" << remote_apk << "on device" << serial;
+    adb.start(ADB, {"-s", serial, "shell", "pm", "install", "-r", remote_apk});
+    co_await ProcessWatchdog::waitForFinished(basic_process, installStallTimeout());
+    QString output = QString(basic_process.readAllStandardOutput()) + basic_process.readAllStandardError();
+
+    // if the signatures do not match previously installed version, try to uninstall the app first
+    if (output.contains("signatures do not match")) {
+        qWarning() << "Signatures do not match previously installed version, try uninstall the app first";
+        qWarning() << "Uninstalling" << package_name << "on device" << serial;
+        if (co_await runAdbCommand(serial, {"uninstall", package_name})) {
+            qDebug() << "Reinstalling" << remote_apk << "on device" << serial;
+            adb.start(ADB, {"-s", serial, "shell", "pm", "install", "-r", remote_apk});
+            co_await ProcessWatchdog::waitForFinished(basic_process, installStallTimeout());
+            output = QString(basic_process.readAllStandardOutput()) + basic_process.readAllStandardError();
+        }
+    }
+
+    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0 || !output.contains("Success")) {
+        qWarning() << "Failed to install" << remote_apk << "on device" << serial;
+        qWarning() << output;
+        co_return false;
+    }
+    co_return true;
+}
+
+QCoro::Task<void> DeviceManager::uninstallIfSignatureMismatch(const QString serial, const QString apk_path, const QString package_name)
+{
+    // Apks without a v2/v3 signature are left to the retry after a failed install
+    const QByteArray certificate = ApkSignature::signingCertificate(apk_path);
+    if (certificate.isEmpty()) {
+        co_return;
+    }
+
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+    adb.start(ADB, {"-s", serial, "shell", "dumpsys", "package", package_name});
+    co_await ProcessWatchdog::waitForFinished(basic_process);
+
+    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
+        co_return;
+    }
+
+    /* EXAMPLE OUTPUT:
+        ...
+        signatures=PackageSignatures{6f1e1d3 version:2, signatures:[1e4dbfd4], past signatures:[]}
+        ...
+    */
+    QRegularExpression re("signatures:\\[([0-9a-f, ]*)\\]");
+    auto match = re.match(QString(basic_process.readAllStandardOutput()));
+    if (!match.hasMatch()) {
+        // Not installed
+        co_return;
+    }
+
+    const QStringList installed_digests = match.captured(1).split(", ", Qt::SkipEmptyParts);
+    if (installed_digests.contains(ApkSignature::packageManagerDigest(certificate))) {
+        co_return;
+    }
+
+    qWarning() << "Signatures do not match previously installed version of" << package_name << ", uninstalling it before installing";
+    co_await runAdbCommand(serial, {"uninstall", package_name});
+}
+
+QCoro::Task<bool> DeviceManager::runAdbCommand(const QString serial, const QStringList args)
+{
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+    adb.start(ADB, QStringList{"-s", serial} + args);
+    co_await ProcessWatchdog::waitForFinished(basic_process);
+
+    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
+        qWarning() << "Failed to run adb" << args << "on device" << serial;
+        qWarning() << basic_process.readAllStandardError();
+        co_return false;
+    }
+    co_return true;
+}
+
+QCoro::Task<bool> DeviceManager::pushObb(const QString serial, const QString obb_path, const QString package_name, const QString new_package_name)
+{
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+    const QString obb_dst_dir = "/sdcard/Android/obb/" + new_package_name;
+
+    qDebug() << "Pushing obb file for" << new_package_name << "to device" << serial;
+    adb.start(ADB, {"-s", serial, "shell", "rm", "-rf", obb_dst_dir, "&&", "mkdir", obb_dst_dir});
+    co_await ProcessWatchdog::waitForFinished(basic_process);
+
+    QList<QPair<QString, QString>> obb_files;
+    QDir obb_dir(obb_path);
+    for (const QString &obb_file : obb_dir.entryList(QStringList() << "*", QDir::Files)) {
+        QString dst_file_name = obb_file;
+        if (new_package_name != package_name)
+            dst_file_name.replace(package_name, new_package_name);
+        obb_files.append({obb_path + "/" + obb_file, obb_dst_dir + "/" + dst_file_name});
+    }
+
+    // Push all obb files back to back over a single sync session
+    AdbSync sync(serial);
+    connect(&sync, &AdbSync::progress, this, [this, serial, package_name](qint64 bytes_sent, qint64 bytes_total, double bytes_per_second) {
+        emit pushProgressChanged(serial, package_name, bytes_sent, bytes_total, bytes_per_second);
+    });
+
+    if (co_await sync.push(obb_files)) {
+        co_return true;
+    }
+
+    // Fall back to one adb push per file, e.g. when the adb server is not reachable over tcp
+    qWarning() << "Sync push failed, falling back to adb push:" << sync.errorString();
+    for (const auto &[src, dst] : obb_files) {
+        qDebug() << "Pushing" << src << "to device" << serial;
+        adb.start(ADB, {"-s", serial, "push", src, dst});
+        co_await ProcessWatchdog::waitForFinished(basic_process, pushStallTimeout());
+        if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
+            qWarning() << "Failed to push obb file for" << new_package_name << "on device" << serial;
+            qWarning() << basic_process.readAllStandardError();
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+QCoro::Task<bool> DeviceManager::uninstallApk(const QString package_name, bool update_device_info)
+{
+    if (!hasConnectedDevice()) {
+        co_return false;
+    }
+
+    auto serial = connectedDevice();
+
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+    adb.start(ADB, {"-s", serial, "uninstall", package_name});
+    co_await ProcessWatchdog::waitForFinished(basic_process);
+
+    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
+        qWarning() << "Failed to uninstall" << package_name << "on device" << serial;
+        qWarning() << basic_process.readAllStandardError();
+        co_return false;
+    }
+
+    if (update_device_info) {
+        updateDeviceInfo();
+    }
+    co_return true;
+}
+
+QCoro::Task<bool> DeviceManager::connectToWirelessDevice(const QString address /*host:port*/)
+{
+    if (address.isEmpty()) {
+        qWarning() << "Empty address";
+        co_return false;
+    }
+
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+    adb.start(ADB, {"connect", address});
+    co_await adb.waitForFinished();
 
+    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
+        qWarning() << "Failed to connect to" << address;
+        qWarning() << basic_process.readAllStandardError();
+
+        co_return false;
+    }
+
+    auto output = basic_process.readAllStandardOutput();
+
+    if (!output.startsWith("connected to " + address.toLocal8Bit()) && !output.contains("already connected to " + address.toLocal8Bit())) {
+        qWarning() << output;
+        co_return false;
+    }
+
+    co_await updateSerials();
+    connectToDevice(address);
+    co_return true;
+}
+
+QCoro::Task<bool> DeviceManager::enableTcpMode(int port)
+{
+    if (!hasConnectedDevice()) {
+        co_return false;
+    }
+
+    if (port < 1024 || port > 65535) {
+        qWarning() << "Invalid port" << port;
+        co_return false;
+    }
+
+    auto serial = connectedDevice();
+
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+    adb.start(ADB, {"-s", serial, "tcpip", QString::number(port)});
+    co_await adb.waitForFinished(5000);
+
+    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
+        qWarning() << "Failed to enable tcp mode on device" << serial;
+        qWarning() << basic_process.readAllStandardError();
+        co_return false;
+    }
+
+    qDebug() << basic_process.readAllStandardOutput();
+
+    co_return true;
+}
+
+QCoro::Task<void> DeviceManager::updateUsers()
+{
+    if (!hasConnectedDevice()) {
+        users_list_.clear();
+        emit usersListChanged();
+        co_return;
+    }
+
+    auto serial = connectedDevice();
+
+    QProcess basic_process;
+    auto adb = qCoro(basic_process);
+    adb.start(ADB, {"-s", serial, "shell", "pm", "list", "users"});
+
+    co_await adb.waitForFinished();
+
+    // The users restored from the last known device state stay until the device answers
     if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
         qWarning() << "Failed to get users for device" << serial;
         co_return;
@@ -889,33 +1995,47 @@ QCoro::Task<void> DeviceManager::updateUsers()
 
     QRegularExpression re(R"(UserInfo\{(\d+):([^:]+):([^}]+)\})");
 
-    int selected_user_id = -1;
+    QList<QSharedPointer<User>> users;
     for (const QString &line : lines) {
         auto match = re.match(line);
         if (match.hasMatch()) {
-            auto user = QSharedPointer<User>(new User(match.captured(1).toInt(), match.captured(2).trimmed(), line.contains("running")));
-            users_list_.append(user);
+            users.append(QSharedPointer<User>(new User(match.captured(1).toInt(), match.captured(2).trimmed(), line.contains("running"))));
+        }
+    }
 
-            if (selected_user_ != nullptr && selected_user_->id == user->id) {
-                selected_user_ = user;
-                selected_user_id = user->id;
-                emit userInfoChanged();
-            }
+    if (users.isEmpty()) {
+        qWarning() << "No users found";
+        co_return;
+    }
 
-            if (user->running) {
-                running_user_name_ = user->name;
+    int selected_user_id = -1;
+    for (const auto &user : users) {
+        // Keep the app counts known so far, updateUserPackages refreshes them
+        for (const auto &old_user : users_list_) {
+            if (old_user->id == user->id) {
+                user->installedApps = old_user->installedApps;
             }
         }
+
+        if (selected_user_ != nullptr && selected_user_->id == user->id) {
+            selected_user_ = user;
+            selected_user_id = user->id;
+        }
+
+        if (user->running) {
+            running_user_name_ = user->name;
+        }
     }
 
-    if (users_list_.isEmpty()) {
-        qWarning() << "No users found";
-        co_return;
-    } else if (selected_user_id == -1) {
+    users_list_ = users;
+    if (selected_user_id == -1) {
         selectUser(0);
+    } else {
+        emit userInfoChanged();
     }
 
     emit usersListChanged();
+    updateUserPackages();
 }
 
 QCoro::Task<void> DeviceManager::selectUser(int index)
@@ -931,56 +2051,107 @@ QCoro::Task<void> DeviceManager::selectUser(int index)
 
 QCoro::Task<void> DeviceManager::listPackagesForUser()
 {
-    user_apps_list_model_.clear();
-    if (!hasConnectedDevice()) {
+    // Switching users only reads the cache, updateUsers lists the packages of all users together
+    if (!hasConnectedDevice() || !selected_user_ || user_packages_serial_ != connectedDevice() || !user_packages_.contains(selected_user_->id)) {
+        user_apps_list_owner_.clear();
+        if (!user_apps_list_model_.syncByPackageName({}).isEmpty()) {
+            emit userAppsListChanged();
+        }
+        co_return;
+    }
+    auto serial = connectedDevice();
+
+    QString id = QString::number(selected_user_->id);
+    const QList<GameInfo> apps = user_packages_.value(selected_user_->id);
+
+    // Another user with the same apps still needs its counters refreshed
+    const QString owner = serial + "/" + id;
+    bool changed = !user_apps_list_model_.syncByPackageName(apps).isEmpty() || owner != user_apps_list_owner_;
+    user_apps_list_owner_ = owner;
+    selected_user_->installedApps = user_apps_list_model_.size();
+
+    const size_t available_count = user_apps_available_list_model_.size();
+    updateAvailableAppsList();
+    changed = changed || available_count != user_apps_available_list_model_.size();
+    if (changed) {
         emit userAppsListChanged();
+    }
+    co_return;
+}
+
+QCoro::Task<void> DeviceManager::updateUserPackages()
+{
+    if (!hasConnectedDevice() || users_list_.isEmpty()) {
         co_return;
     }
     auto serial = connectedDevice();
 
+    // One shell session for every user instead of one adb round trip per user
+    QStringList ids;
+    for (const auto &user : users_list_) {
+        ids.append(QString::number(user->id));
+    }
+    QString script = QString("for u in %1; do echo \"user:$u\"; pm list packages --user $u --show-versioncode -3; done").arg(ids.join(' '));
+
     QProcess basic_process;
-    QString id = QString::number(selected_user_->id);
     auto adb = qCoro(basic_process);
-    adb.start(ADB, {"-s", serial, "shell", "pm", "list", "packages", "--user", id, "--show-versioncode", "-3"});
-
+    adb.start(ADB, {"-s", serial, "shell", script});
     co_await adb.waitForFinished();
 
-    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
-        qWarning() << "Failed to get apps for device" << serial;
+    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0 || serial != connectedDevice()) {
+        qWarning() << "Failed to get apps of users for device" << serial;
         co_return;
     }
 
     /* EXAMPLE OUTPUT:
+        user:0
         package:com.facebook.arvr.quillplayer versionCode:135
         package:com.oculus.mobile_mrc_setup versionCode:1637173263
+        user:10
+        package:com.facebook.arvr.quillplayer versionCode:135
     */
     QString output = basic_process.readAllStandardOutput();
     QStringList lines = output.split("\n");
     lines.removeAll("");
+    QRegularExpression user_re("^user:(\\d+)");
     QRegularExpression re("package:(\\S+) versionCode:(\\d+)");
 
-    user_apps_list_model_.clear();
+    QHash<int, QList<GameInfo>> user_packages;
+    for (const QString &id : ids) {
+        user_packages[id.toInt()] = {};
+    }
+
+    int user_id = -1;
     for (const QString &line : lines) {
+        auto user_match = user_re.match(line);
+        if (user_match.hasMatch()) {
+            user_id = user_match.captured(1).toInt();
+            continue;
+        }
+
         auto match = re.match(line);
-        if (match.hasMatch()) {
+        if (match.hasMatch() && user_packages.contains(user_id)) {
             QString package_name = match.captured(1);
             QString version_code = match.captured(2);
-            auto app = GameInfo{.package_name = package_name, .version_code = version_code};
+            GameInfo app{.package_name = package_name, .version_code = version_code};
+            app.intern();
+            user_packages[user_id].append(app);
+        }
+    }
 
-            user_apps_list_model_.append(app);
+    for (const auto &user : users_list_) {
+        if (user_packages.contains(user->id)) {
+            user->installedApps = user_packages[user->id].size();
         }
     }
-    selected_user_->installedApps = user_apps_list_model_.size();
+    user_packages_ = user_packages;
+    user_packages_serial_ = serial;
 
-    updateAvailableAppsList();
-    emit userAppsListChanged();
-    co_return;
+    listPackagesForUser();
 }
 
 QCoro::Task<void> DeviceManager::updateAvailableAppsList()
 {
-    user_apps_available_list_model_.clear();
-
     QSet<QString> installedAppsSet;
 
     // Adiciona todos os pacotes instalados ao conjunto
@@ -989,58 +2160,117 @@ QCoro::Task<void> DeviceManager::updateAvailableAppsList()
     }
 
     // Adiciona todos os pacotes disponíveis, exceto os já instalados
+    QList<GameInfo> available_apps;
     for (size_t i = 0; i < app_list_model_.size(); ++i) {
         if (!installedAppsSet.contains(app_list_model_[i].package_name)) {
-            user_apps_available_list_model_.append(app_list_model_[i]);
+            available_apps.append(app_list_model_[i]);
         }
     }
+    user_apps_available_list_model_.syncByPackageName(available_apps);
     co_return;
 }
 
 QCoro::Task<bool> DeviceManager::uninstallFromUser(const QString package_name)
 {
-    if (!hasConnectedDevice()) {
+    if (!selected_user_) {
         co_return false;
     }
+    co_return co_await uninstallFromUsers({package_name}, {selected_user_->id});
+}
 
-    auto serial = connectedDevice();
-    QString id = QString::number(selected_user_->id);
-
-    QProcess basic_process;
-    auto adb = qCoro(basic_process);
-    adb.start(ADB, {"-s", serial, "shell", "pm", "uninstall", "--user", id, package_name});
-    co_await adb.waitForFinished(-1);
-
-    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
-        qWarning() << "Failed to uninstall" << package_name << "for user" << selected_user_->name << "on device" << serial;
-        qWarning() << basic_process.readAllStandardError();
+QCoro::Task<bool> DeviceManager::installToUser(const QString package_name)
+{
+    if (!selected_user_) {
         co_return false;
     }
+    co_return co_await installToUsers({package_name}, {selected_user_->id});
+}
 
-    listPackagesForUser();
-    co_return true;
+QCoro::Task<bool> DeviceManager::uninstallFromUsers(const QStringList package_names, const QList<int> user_ids)
+{
+    co_return co_await runUserPackageCommands("uninstall", package_names, user_ids);
 }
 
-QCoro::Task<bool> DeviceManager::installToUser(const QString package_name)
+QCoro::Task<bool> DeviceManager::installToUsers(const QStringList package_names, const QList<int> user_ids)
 {
-    if (!hasConnectedDevice()) {
+    co_return co_await runUserPackageCommands("install-existing", package_names, user_ids);
+}
+
+QCoro::Task<bool> DeviceManager::runUserPackageCommands(const QString command, const QStringList package_names, const QList<int> user_ids)
+{
+    if (!hasConnectedDevice() || package_names.isEmpty() || user_ids.isEmpty()) {
         co_return false;
     }
-
     auto serial = connectedDevice();
-    QString id = QString::number(selected_user_->id);
+
+    // Package names end up in a shell script
+    static const QRegularExpression package_re("^[A-Za-z0-9_.]+$");
+    for (const QString &package_name : package_names) {
+        if (!package_re.match(package_name).hasMatch()) {
+            qWarning() << "Invalid package name" << package_name;
+            co_return false;
+        }
+    }
+
+    // One shell session for every package and user, each command is followed by its exit code
+    QStringList commands;
+    for (int user_id : user_ids) {
+        for (const QString &package_name : package_names) {
+            commands.append(QString("pm %1 --user %2 %3 2>&1; echo \"result:$?:%2:%3\"").arg(command).arg(user_id).arg(package_name));
+        }
+    }
 
     QProcess basic_process;
     auto adb = qCoro(basic_process);
-    adb.start(ADB, {"-s", serial, "shell", "pm", "install-existing", "--user", id, package_name});
-    co_await adb.waitForFinished(-1);
+    adb.start(ADB, {"-s", serial, "shell", commands.join("; ")});
+    co_await ProcessWatchdog::waitForFinished(basic_process);
 
-    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
-        qWarning() << "Failed to install" << package_name << "for user" << selected_user_->name << "on device" << serial;
+    if (basic_process.exitStatus() != QProcess::NormalExit) {
+        qWarning() << "Failed to run pm" << command << "on device" << serial;
         qWarning() << basic_process.readAllStandardError();
         co_return false;
     }
 
-    listPackagesForUser();
-    co_return true;
+    /* EXAMPLE OUTPUT:
+        Success
+        result:0:10:com.facebook.arvr.quillplayer
+        Failure [not installed for 11]
+        result:1:11:com.facebook.arvr.quillplayer
+    */
+    QString output = basic_process.readAllStandardOutput();
+    QRegularExpression result_re("^result:(\\d+):(\\d+):(\\S+)$");
+    int done = 0;
+    bool success = true;
+    QStringList pm_output;
+    for (const QString &line : output.split("\n", Qt::SkipEmptyParts)) {
+        auto match = result_re.match(line.trimmed());
+        if (!match.hasMatch()) {
+            pm_output.append(line.trimmed());
+            continue;
+        }
+
+        ++done;
+        if (match.captured(1) != "0") {
+            qWarning() << "Failed to" << command << match.captured(3) << "for user" << match.captured(2) << "on device" << serial << pm_output.join(" ");
+            success = false;
+        }
+        pm_output.clear();
+    }
+
+    if (done != commands.size()) {
+        qWarning() << "pm" << command << "finished" << done << "of" << commands.size() << "operations on device" << serial;
+        success = false;
+    }
+
+    updateUserPackages();
+    co_return success;
+}
+
+QList<int> DeviceManager::toUserIds(const QVariantList &user_ids)
+{
+    QList<int> ids;
+    for (const QVariant &id : user_ids) {
+        ids.append(id.toInt());
+    }
+    return ids;
 }
\ No newline at end of file
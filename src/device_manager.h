@@ -21,16 +21,20 @@
 
 #include "models/game_info_model.h"
 #include "models/user.h"
+#include "renamed_apk_cache.h"
 #include <QCoroProcess>
 #include <QCoroQmlTask>
+#include <QHash>
 #include <QSharedPointer>
 #include <QVariantList>
+#include <QVariantMap>
 
 class QFileInfo;
 
 class DeviceManager : public QObject
 {
     Q_OBJECT
+    Q_ENUMS(InstallState)
 
     Q_PROPERTY(QVariantList devicesList READ devicesList NOTIFY devicesListChanged);
     Q_PROPERTY(QString connectedDevice READ connectedDevice WRITE connectToDevice NOTIFY connectedDeviceChanged)
@@ -53,20 +57,44 @@ class DeviceManager : public QObject
     Q_PROPERTY(int selectedUsersInstalledApps READ selectedUsersInstalledApps NOTIFY userInfoChanged)
     Q_PROPERTY(int availableAppsCount READ availableAppsCount)
     Q_PROPERTY(QString runningUserName READ runningUserName NOTIFY userInfoChanged)
+    Q_PROPERTY(bool archiveInstallSupported READ archiveInstallSupported CONSTANT)
 public:
+    enum InstallState { Queued, Staging, Installing, Installed, Failed };
+
     explicit DeviceManager(QObject *parent = nullptr);
     ~DeviceManager();
 
     Q_INVOKABLE QCoro::Task<bool> startServer();
     Q_INVOKABLE QCoro::Task<bool> restartServer();
-    QCoro::Task<bool> renameApk(const QFileInfo apk_file, const QString package_name, const QString new_package_name);
+    // Path of the renamed and signed apk, empty on failure
+    QCoro::Task<QString> renameApk(const QFileInfo apk_file, const QString package_name, const QString new_package_name);
+    QCoro::Task<bool> rebuildApk(const QFileInfo apk_file, const QString package_name, const QString new_package_name);
+    QCoro::Task<bool> signApk(const QString new_apk_file);
+    // Queue an install on the connected device, the package manager runs one install at a time per device
     QCoro::Task<bool> installApk(const QString path, const QString package_name, bool rename_package = false);
 
+    // Install straight from a (multi-volume) 7z archive, nothing is extracted to disk
+    QCoro::Task<bool> installApkFromArchive(const QString archive_path, const QString password, const QString package_name);
+
+    // 7za is paused with SIGSTOP while the device catches up, without it QProcess would buffer the whole apk in memory
+    static bool archiveInstallSupported()
+    {
+#ifdef Q_OS_UNIX
+        return true;
+#else
+        return false;
+#endif
+    }
+
     Q_INVOKABLE QCoro::QmlTask installApkQml(const QString path, const QString package_name)
     {
         return installApk(path, package_name);
     }
 
+    // Install to several devices at once, local files are read once and streamed to every device
+    // QML goes through VrpManager::installToDevicesQml, which applies the rename setting and tracks the game status
+    QCoro::Task<QVariantMap> installApkToDevices(const QStringList serials, const QString path, const QString package_name, bool rename_package = false);
+
     QCoro::Task<bool> uninstallApk(const QString package_name, bool update_device_info = true);
     Q_INVOKABLE QCoro::QmlTask uninstallApkQml(const QString package_name)
     {
@@ -83,6 +111,16 @@ public:
         return installToUser(package_name);
     };
 
+    Q_INVOKABLE QCoro::QmlTask uninstallFromUsersQml(const QStringList &package_names, const QVariantList &user_ids)
+    {
+        return uninstallFromUsers(package_names, toUserIds(user_ids));
+    };
+
+    Q_INVOKABLE QCoro::QmlTask installToUsersQml(const QStringList &package_names, const QVariantList &user_ids)
+    {
+        return installToUsers(package_names, toUserIds(user_ids));
+    };
+
     Q_INVOKABLE QVariantList devicesList() const
     {
         QVariantList list;
@@ -122,9 +160,13 @@ public:
     Q_INVOKABLE QCoro::Task<void> updateUsers();
     Q_INVOKABLE QCoro::Task<void> selectUser(int index);
     Q_INVOKABLE QCoro::Task<void> listPackagesForUser();
+    Q_INVOKABLE QCoro::Task<void> updateUserPackages();
     Q_INVOKABLE QCoro::Task<void> updateAvailableAppsList();
     Q_INVOKABLE QCoro::Task<bool> uninstallFromUser(const QString package_name);
     Q_INVOKABLE QCoro::Task<bool> installToUser(const QString package_name);
+    // Every package for every user in one shell session, the user packages are refreshed once at the end
+    QCoro::Task<bool> uninstallFromUsers(const QStringList package_names, const QList<int> user_ids);
+    QCoro::Task<bool> installToUsers(const QStringList package_names, const QList<int> user_ids);
 
     Q_INVOKABLE QString selectedUserName() const
     {
@@ -146,6 +188,12 @@ public:
         return selected_user_ ? selected_user_->installedApps : -1;
     }
 
+    // Null if the package isn't installed on the connected device
+    QString installedVersionCode(const QString &package_name) const
+    {
+        return installed_versions_.value(package_name);
+    }
+
     Q_INVOKABLE int availableAppsCount() const
     {
         return user_apps_available_list_model_.size();
@@ -320,7 +368,8 @@ public:
 
 signals:
     void devicesListChanged();
-    void appListChanged();
+    // Package names that were installed, removed or updated on the connected device
+    void appListChanged(QStringList changed_packages);
     void connectedDeviceChanged();
     void deviceNameChanged(QString device_name);
     void deviceIpChanged(QString device_ip);
@@ -334,13 +383,72 @@ signals:
     void userAppsListChanged();
     void usersListChanged();
     void userInfoChanged();
+    void installStateChanged(QString serial, QString package_name, DeviceManager::InstallState state);
+    void installJobFinished(quint64 job_id);
+    void deviceInstallFinished(QString serial, QString package_name, bool success);
+    void pushProgressChanged(QString serial, QString package_name, qint64 bytes_pushed, qint64 bytes_total, double bytes_per_second);
 
 private:
+    struct InstallJob {
+        quint64 id = 0;
+        QString serial;
+        QString path;
+        QString package_name;
+        QString new_package_name;
+        QString archive_path;
+        QString archive_password;
+        qint64 install_size = 0; // bytes the job takes on the device
+        bool rename_package = false;
+        bool installing = false;
+        bool finished = false;
+        bool result = false;
+        QStringList local_apks;
+        QStringList staged_apks; // apk paths on the device
+        QSharedPointer<QCoro::Task<bool>> staging;
+    };
+
+    struct InstallCapabilities {
+        bool streaming = false; // adb install --streaming
+        bool incremental = false; // adb install --incremental
+    };
+
+    QCoro::Task<bool> enqueueInstall(QSharedPointer<InstallJob> job);
+    QCoro::Task<bool> admitInstall(QSharedPointer<InstallJob> job);
+    QCoro::Task<bool> hasDeviceSpace(const QString serial, const QString package_name, qint64 bytes);
+    // Free bytes on the device, counting the obb files of package_name as free, -1 if unknown
+    QCoro::Task<qint64> deviceFreeSpace(const QString serial, const QString package_name);
+    QCoro::Task<void> runInstallQueue(const QString serial);
+    void startStaging(QSharedPointer<InstallJob> job);
+    void startStagingNext(const QString &serial);
+    QCoro::Task<bool> prepareInstallJob(QSharedPointer<InstallJob> job);
+    QCoro::Task<bool> stageInstallJob(QSharedPointer<InstallJob> job);
+    QCoro::Task<bool> streamArchiveInstall(QSharedPointer<InstallJob> job);
+    QCoro::Task<InstallCapabilities> installCapabilities(const QString serial);
+    QCoro::Task<bool> streamInstall(const QString serial, const QString apk_path, const QString package_name);
+    QCoro::Task<void> grantPermissions(const QString serial, const QString package_name, const QString new_package_name);
+    // local_apk is the local copy of the first remote apk, its signature is checked against the installed package
+    QCoro::Task<bool> installStagedApks(const QString serial,
+                                        const QString local_apk,
+                                        const QStringList remote_apks,
+                                        const QString package_name,
+                                        const QString new_package_name);
+    QCoro::Task<bool> pmInstall(const QString serial, const QString remote_apk, const QString package_name);
+    void setAppList(const QString &serial, const QList<GameInfo> &apps);
+    // Last known state of the connected device, kept in <data path>/devices/<serial>.json
+    void restoreDeviceState();
+    void saveDeviceState();
+    QCoro::Task<void> uninstallIfSignatureMismatch(const QString serial, const QString apk_path, const QString package_name);
+    QCoro::Task<bool> runUserPackageCommands(const QString command, const QStringList package_names, const QList<int> user_ids);
+    static QList<int> toUserIds(const QVariantList &user_ids);
+    QCoro::Task<bool> runAdbCommand(const QString serial, const QStringList args);
+    QCoro::Task<bool> pushObb(const QString serial, const QString obb_path, const QString package_name, const QString new_package_name);
+
     QStringList devices_list_;
     GameInfoModel app_list_model_;
     GameInfoModel user_apps_list_model_;
     GameInfoModel user_apps_available_list_model_;
     QTimer auto_update_timer_;
+    QTimer save_state_timer_;
     QString connected_device_;
     QString device_name_;
     QString device_ip_;
@@ -355,6 +463,16 @@ private:
     QString running_user_name_;
     QList<QSharedPointer<User>> users_list_;
     QSharedPointer<User> selected_user_;
+    QHash<QString, QList<QSharedPointer<InstallJob>>> install_queues_;
+    QHash<QString, InstallCapabilities> install_capabilities_;
+    quint64 last_install_job_id_;
+    RenamedApkCache renamed_apk_cache_;
+    QString app_list_serial_;
+    QHash<QString, QString> installed_versions_;
+    QString user_apps_list_owner_;
+    // Packages of every user of the connected device, by user id
+    QHash<int, QList<GameInfo>> user_packages_;
+    QString user_packages_serial_;
 };
 
 #endif /* QROOKIE_DEVICE_MANAGER */
@@ -0,0 +1,208 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "download_manifest.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+DownloadManifest::DownloadManifest(const QString &dir_path)
+    : dir_path_(dir_path)
+{
+}
+
+QString DownloadManifest::path() const
+{
+    return dir_path_ + "/manifest.json";
+}
+
+bool DownloadManifest::load()
+{
+    QFile file(path());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    volumes_.clear();
+    for (const QJsonValue &value : QJsonDocument::fromJson(file.readAll()).object().value("volumes").toArray()) {
+        const QJsonObject obj = value.toObject();
+        Volume volume;
+        volume.name = obj["name"].toString();
+        volume.size = obj["size"].toInteger();
+        volume.complete = obj["complete"].toBool();
+        bool hashes_ok = true;
+        for (const QJsonValue &hash : obj["block_hashes"].toArray()) {
+            volume.block_hashes.append(hash.toString().toULongLong(&hashes_ok, 16));
+            if (!hashes_ok) {
+                break;
+            }
+        }
+        volume.tail_size = obj["tail_size"].toInteger();
+        if (volume.tail_size > 0 && hashes_ok) {
+            volume.tail_hash = obj["tail_hash"].toString().toULongLong(&hashes_ok, 16);
+        }
+        // Manifests from before the blocks were hashed with XXH64, partial volumes start over
+        if (!hashes_ok) {
+            volume.block_hashes.clear();
+            volume.tail_size = 0;
+            volume.tail_hash = 0;
+        }
+        volume.xxh64 = obj["xxh64"].toString();
+        volume.expected_xxh64 = obj["expected_xxh64"].toString();
+
+        if (volume.name.isEmpty() || volume.size <= 0) {
+            qWarning() << "Invalid volume in" << path();
+            volumes_.clear();
+            return false;
+        }
+        volumes_.append(volume);
+    }
+    return !volumes_.isEmpty();
+}
+
+bool DownloadManifest::save() const
+{
+    QJsonArray volumes;
+    for (const Volume &volume : volumes_) {
+        QJsonArray block_hashes;
+        for (const quint64 hash : volume.block_hashes) {
+            block_hashes.append(XxHash64::toHex(hash));
+        }
+
+        QJsonObject obj{{"name", volume.name}, {"size", volume.size}, {"complete", volume.complete}, {"block_hashes", block_hashes}};
+        if (volume.tail_size > 0) {
+            obj["tail_size"] = volume.tail_size;
+            obj["tail_hash"] = XxHash64::toHex(volume.tail_hash);
+        }
+        if (!volume.xxh64.isEmpty()) {
+            obj["xxh64"] = volume.xxh64;
+        }
+        if (!volume.expected_xxh64.isEmpty()) {
+            obj["expected_xxh64"] = volume.expected_xxh64;
+        }
+        volumes.append(obj);
+    }
+
+    QSaveFile file(path());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open" << path();
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject{{"volumes", volumes}}).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qWarning() << "Failed to save" << path() << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void DownloadManifest::remove()
+{
+    QFile::remove(path());
+    volumes_.clear();
+}
+
+DownloadManifest::Volume *DownloadManifest::volume(const QString &name)
+{
+    for (Volume &volume : volumes_) {
+        if (volume.name == name) {
+            return &volume;
+        }
+    }
+    return nullptr;
+}
+
+qint64 DownloadManifest::totalSize() const
+{
+    qint64 total_size = 0;
+    for (const Volume &volume : volumes_) {
+        total_size += volume.size;
+    }
+    return total_size;
+}
+
+qint64 DownloadManifest::verifyPartial(Volume &volume, const QString &file_path, XxHash64 &tail, XxHash64 &volume_hash)
+{
+    tail.reset();
+    volume_hash.reset();
+    const qint64 tail_size = volume.tail_size;
+    const quint64 tail_hash = volume.tail_hash;
+    volume.tail_size = 0;
+    volume.tail_hash = 0;
+
+    QFile file(file_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        volume.block_hashes.clear();
+        return 0;
+    }
+
+    qsizetype blocks = 0;
+    while (blocks < volume.block_hashes.size()) {
+        const QByteArray data = file.read(BLOCK_SIZE);
+        if (data.size() != BLOCK_SIZE || XxHash64::hash(data) != volume.block_hashes[blocks]) {
+            break;
+        }
+        volume_hash.addData(data);
+        ++blocks;
+    }
+
+    const bool all_blocks = blocks == volume.block_hashes.size();
+    volume.block_hashes.resize(blocks);
+    qint64 verified_size = blocks * BLOCK_SIZE;
+
+    // Without a recorded tail, whatever follows the last block was written after the manifest was saved
+    if (all_blocks && tail_size > 0 && tail_size < BLOCK_SIZE && file.seek(verified_size)) {
+        const QByteArray data = file.read(tail_size);
+        if (data.size() == tail_size && XxHash64::hash(data) == tail_hash) {
+            tail.addData(data);
+            volume_hash.addData(data);
+            verified_size += tail_size;
+        }
+    }
+
+    if (verified_size > volume.size) {
+        volume.block_hashes.clear();
+        tail.reset();
+        volume_hash.reset();
+        return 0;
+    }
+    return verified_size;
+}
+
+bool DownloadManifest::verifyComplete(const Volume &volume, const QString &file_path)
+{
+    QFile file(file_path);
+    if (file.size() != volume.size) {
+        return false;
+    }
+    if (volume.block_hashes.isEmpty()) {
+        return true;
+    }
+
+    if ((volume.size + BLOCK_SIZE - 1) / BLOCK_SIZE != volume.block_hashes.size() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    for (const quint64 hash : volume.block_hashes) {
+        if (XxHash64::hash(file.read(BLOCK_SIZE)) != hash) {
+            return false;
+        }
+    }
+    return true;
+}
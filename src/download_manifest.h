@@ -0,0 +1,91 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_DOWNLOAD_MANIFEST
+#define QROOKIE_DOWNLOAD_MANIFEST
+
+#include "xxhash64.h"
+#include <QList>
+#include <QString>
+
+// Volumes of a game in the download cache, saved as manifest.json next to them.
+// An interrupted download resumes from it without listing the server again, and partial volumes
+// are checked block by block so only data that was recorded as written is kept.
+class DownloadManifest
+{
+public:
+    // Partial volumes are recorded, verified and resumed in blocks of this size, every block is hashed with XXH64
+    static constexpr qint64 BLOCK_SIZE = 16 * 1024 * 1024;
+
+    struct Volume {
+        QString name;
+        // Size in the server listing
+        qint64 size = 0;
+        bool complete = false;
+        // One hash per block written so far, the last block of a complete volume may be short
+        QList<quint64> block_hashes;
+        // Bytes after the last full block of a partial volume, recorded when its download stopped
+        qint64 tail_size = 0;
+        quint64 tail_hash = 0;
+        // XXH64 of the whole volume, hashed while it was written
+        QString xxh64;
+        // XXH64 the server publishes for the volume, if it does
+        QString expected_xxh64;
+
+        // Forget what was downloaded, keep what is known from the server
+        void reset()
+        {
+            Volume volume{name, size};
+            volume.expected_xxh64 = expected_xxh64;
+            *this = volume;
+        }
+    };
+
+    explicit DownloadManifest(const QString &dir_path);
+
+    QString path() const;
+    bool load();
+    bool save() const;
+    void remove();
+
+    QList<Volume> &volumes()
+    {
+        return volumes_;
+    }
+    void setVolumes(const QList<Volume> &volumes)
+    {
+        volumes_ = volumes;
+    }
+    Volume *volume(const QString &name);
+    qint64 totalSize() const;
+
+    // Keep the prefix of a partial volume that matches its recorded hashes and forget the rest.
+    // Returns the number of bytes to keep, tail is left holding the hash state of the last incomplete block
+    // and volume_hash the state of the whole volume. Reads the whole prefix, call it off the gui thread.
+    static qint64 verifyPartial(Volume &volume, const QString &file_path, XxHash64 &tail, XxHash64 &volume_hash);
+
+    // Whether a complete volume still has its listed size and recorded hashes. Volumes adopted without
+    // hashes can only be checked by size. Reads the whole volume, call it off the gui thread.
+    static bool verifyComplete(const Volume &volume, const QString &file_path);
+
+private:
+    QString dir_path_;
+    QList<Volume> volumes_;
+};
+
+#endif /* QROOKIE_DOWNLOAD_MANIFEST */
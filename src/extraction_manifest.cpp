@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "extraction_manifest.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <zlib.h>
+
+// Same format as the CRC column of `7za l -slt`
+static QString fileCrc(const QString &file_path)
+{
+    QFile file(file_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    while (!file.atEnd()) {
+        const QByteArray data = file.read(4 * 1024 * 1024);
+        if (data.isEmpty()) {
+            return {};
+        }
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(data.constData()), data.size());
+    }
+    return QString::number(crc, 16).toUpper().rightJustified(8, '0');
+}
+
+bool ExtractionManifest::save(const QString &manifest_path, const QString &output_dir, const QList<ArchiveEntry> &entries)
+{
+    QJsonArray files;
+    for (const ArchiveEntry &entry : entries) {
+        if (entry.is_dir) {
+            continue;
+        }
+
+        QFileInfo info(output_dir + "/" + entry.path);
+        if (!info.exists() || info.size() != entry.size) {
+            qWarning() << "Extracted file doesn't match the archive:" << info.filePath();
+            return false;
+        }
+        files.append(QJsonObject{{"path", entry.path},
+                                 {"size", entry.size},
+                                 {"crc", entry.crc},
+                                 {"modified", info.lastModified().toMSecsSinceEpoch()}});
+    }
+
+    QDir().mkpath(QFileInfo(manifest_path).absolutePath());
+    QSaveFile file(manifest_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open" << manifest_path;
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject{{"files", files}}).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qWarning() << "Failed to save" << manifest_path << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool ExtractionManifest::isIntact(const QString &manifest_path, const QString &output_dir)
+{
+    QFile file(manifest_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QJsonArray files = QJsonDocument::fromJson(file.readAll()).object().value("files").toArray();
+    if (files.isEmpty()) {
+        return false;
+    }
+
+    for (const QJsonValue &value : files) {
+        const QJsonObject obj = value.toObject();
+        const QFileInfo info(output_dir + "/" + obj["path"].toString());
+        if (!info.exists() || info.size() != obj["size"].toInteger()
+            || info.lastModified().toMSecsSinceEpoch() != obj["modified"].toInteger()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ExtractionManifest::matches(const QString &manifest_path, const QString &output_dir, const QList<ArchiveEntry> &entries)
+{
+    QFile file(manifest_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QHash<QString, QJsonObject> recorded;
+    for (const QJsonValue &value : QJsonDocument::fromJson(file.readAll()).object().value("files").toArray()) {
+        const QJsonObject obj = value.toObject();
+        recorded.insert(obj["path"].toString(), obj);
+    }
+
+    // Only an extraction of the very same archive content counts
+    qsizetype files = 0;
+    for (const ArchiveEntry &entry : entries) {
+        if (entry.is_dir) {
+            continue;
+        }
+        ++files;
+
+        const QJsonObject obj = recorded.value(entry.path);
+        if (obj.isEmpty() || obj["size"].toInteger() != entry.size || obj["crc"].toString() != entry.crc) {
+            return false;
+        }
+    }
+    if (files == 0 || files != recorded.size()) {
+        return false;
+    }
+
+    for (const ArchiveEntry &entry : entries) {
+        if (entry.is_dir) {
+            continue;
+        }
+
+        const QString path = output_dir + "/" + entry.path;
+        const QFileInfo info(path);
+        if (!info.exists() || info.size() != entry.size) {
+            return false;
+        }
+        // Touched since, it's still fine if the content is the same
+        if (info.lastModified().toMSecsSinceEpoch() != recorded.value(entry.path)["modified"].toInteger() && !entry.crc.isEmpty()
+            && fileCrc(path) != entry.crc) {
+            return false;
+        }
+    }
+    return true;
+}
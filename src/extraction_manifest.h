@@ -0,0 +1,44 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_EXTRACTION_MANIFEST
+#define QROOKIE_EXTRACTION_MANIFEST
+
+#include "seven_zip.h"
+#include <QList>
+#include <QString>
+
+// What an archive was extracted to: path, size, crc and modification time of every file.
+// Lets the extraction of the same archive be skipped while the extracted files are still intact.
+class ExtractionManifest
+{
+public:
+    // Record the files of entries as extracted into output_dir. The crcs come from the archive,
+    // 7za checks them while extracting so nothing has to be read back.
+    static bool save(const QString &manifest_path, const QString &output_dir, const QList<ArchiveEntry> &entries);
+
+    // Whether entries were extracted into output_dir and are still as recorded. Sizes and modification times
+    // are enough for unchanged files, the others are checked against their crc so call it off the gui thread.
+    static bool matches(const QString &manifest_path, const QString &output_dir, const QList<ArchiveEntry> &entries);
+
+    // Whether the recorded files are all still in output_dir with their recorded sizes and modification times.
+    // Needs neither the archive nor reading any file, for when the archive is gone from the cache.
+    static bool isIntact(const QString &manifest_path, const QString &output_dir);
+};
+
+#endif /* QROOKIE_EXTRACTION_MANIFEST */
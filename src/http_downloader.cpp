@@ -16,6 +16,7 @@
  */
 
 #include "http_downloader.h"
+#include "worker_thread.h"
 
 #include <QCoroIODevice>
 #include <QCoroNetworkReply>
@@ -24,6 +25,7 @@
 #include <QDomElement>
 #include <QDomNode>
 #include <QFile>
+#include <QFileInfo>
 #include <QNetworkReply>
 #include <QRegularExpression>
 #include <QSharedPointer>
@@ -36,12 +38,29 @@ HttpDownloader::HttpDownloader(QObject *parent)
 {
 }
 
-QCoro::Task<bool> HttpDownloader::download(const QString file_path)
+QCoro::Task<bool> HttpDownloader::download(const QString file_path, DownloadManifest *manifest)
 {
     QString filename = download_directory_ + "/" + file_path;
     QString tmp_filename = filename + ".tmp";
+    DownloadManifest::Volume *volume = manifest ? manifest->volume(QFileInfo(file_path).fileName()) : nullptr;
 
-    if (QFile::exists(filename)) {
+    if (volume) {
+        // Volumes finished before there was a manifest are taken as they are
+        const qint64 size = QFileInfo(filename).size();
+        if (volume->complete && size == volume->size) {
+            co_return true;
+        } else if (!volume->complete && size == volume->size) {
+            qDebug() << "File already exists: " << filename;
+            volume->complete = true;
+            manifest->save();
+            co_return true;
+        } else if (volume->complete || QFile::exists(filename)) {
+            qWarning() << "Downloaded volume changed, downloading it again: " << filename;
+            QFile::remove(filename);
+            volume->reset();
+            manifest->save();
+        }
+    } else if (QFile::exists(filename)) {
         qDebug() << "File already exists: " << filename;
         co_return true;
     }
@@ -49,11 +68,27 @@ QCoro::Task<bool> HttpDownloader::download(const QString file_path)
     QFile file(tmp_filename);
     QIODeviceBase::OpenMode open_mode;
     qint64 downloaded_bytes_ = 0;
+    // State of the block being written, hashes of full blocks go to the manifest
+    XxHash64 block_hash;
+    XxHash64 volume_hash;
 
     if (file.exists()) {
         qDebug() << "Temp file exists: " << tmp_filename;
         open_mode = QIODevice::WriteOnly | QIODevice::Append;
         downloaded_bytes_ = file.size();
+
+        if (volume) {
+            // Up to several hundred MB to read, don't block the ui
+            co_await runInWorkerThread([&]() {
+                downloaded_bytes_ = DownloadManifest::verifyPartial(*volume, tmp_filename, block_hash, volume_hash);
+            });
+
+            if (downloaded_bytes_ != file.size()) {
+                qWarning() << "Discarding" << file.size() - downloaded_bytes_ << "unverified bytes of" << tmp_filename;
+                file.resize(downloaded_bytes_);
+            }
+            manifest->save();
+        }
     } else {
         open_mode = QIODevice::WriteOnly | QIODevice::Truncate;
     }
@@ -63,6 +98,55 @@ QCoro::Task<bool> HttpDownloader::download(const QString file_path)
         co_return false;
     }
 
+    qint64 block_fill = downloaded_bytes_ % DownloadManifest::BLOCK_SIZE;
+    auto write = [&](const QByteArray &data) {
+        file.write(data);
+        if (!volume) {
+            return;
+        }
+
+        volume_hash.addData(data);
+        for (qint64 pos = 0; pos < data.size();) {
+            const qint64 length = qMin<qint64>(data.size() - pos, DownloadManifest::BLOCK_SIZE - block_fill);
+            block_hash.addData(QByteArrayView(data).sliced(pos, length));
+            block_fill += length;
+            pos += length;
+            if (block_fill == DownloadManifest::BLOCK_SIZE) {
+                // The block has to reach the file before the manifest claims it
+                file.flush();
+                volume->block_hashes.append(block_hash.result());
+                block_hash.reset();
+                block_fill = 0;
+                manifest->save();
+            }
+        }
+    };
+
+    // Record a volume whose bytes are all in the temp file, unless they don't match what the server publishes
+    auto complete = [&]() {
+        volume->xxh64 = XxHash64::toHex(volume_hash.result());
+        if (!volume->expected_xxh64.isEmpty() && volume->xxh64 != volume->expected_xxh64) {
+            qWarning() << "Downloading Error: XXH64 is" << volume->xxh64 << "but the server has" << volume->expected_xxh64 << ": " << filename;
+            file.remove();
+            volume->reset();
+            manifest->save();
+            return false;
+        }
+
+        if (block_fill > 0) {
+            volume->block_hashes.append(block_hash.result());
+        }
+        volume->complete = true;
+        file.rename(filename);
+        manifest->save();
+        return true;
+    };
+
+    if (volume && downloaded_bytes_ == volume->size) {
+        // Only the rename was missing
+        co_return complete();
+    }
+
     QUrl url = base_url_ + file_path;
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::UserAgentHeader, "rclone/v1.65.2");
@@ -77,6 +161,7 @@ QCoro::Task<bool> HttpDownloader::download(const QString file_path)
 
     qDebug() << "Downloading: " << url;
     bool result = false;
+    bool range_checked = downloaded_bytes_ == 0;
     while (true) {
         if (!abort_files_.isEmpty() && abort_files_.top() == file_path) {
             abort_files_.pop();
@@ -93,37 +178,78 @@ QCoro::Task<bool> HttpDownloader::download(const QString file_path)
             break;
         }
 
+        // A server that ignores the range sends the whole file, appending it would corrupt the partial one
+        const QVariant status_code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+        if (!range_checked && status_code.isValid()) {
+            range_checked = true;
+            if (status_code.toInt() != 206) {
+                qWarning() << "Downloading Error: Range not supported, discarding partial file: " << url;
+                reply->abort();
+                file.remove();
+                if (volume) {
+                    volume->reset();
+                    manifest->save();
+                }
+                break;
+            }
+        }
+
         if (reply->isFinished()) {
-            file.write(reply->readAll());
+            write(reply->readAll());
             result = true;
             qDebug() << "Downloaded: " << url;
-
-            file.rename(filename);
             break;
         }
 
         co_await device.waitForReadyRead(1000);
-        file.write(reply->readAll());
+        write(reply->readAll());
     }
 
     reply->deleteLater();
-    co_return result;
+    if (!volume) {
+        if (result) {
+            file.rename(filename);
+        }
+        co_return result;
+    }
+
+    if (result && file.size() != volume->size) {
+        // The listing in the manifest no longer matches the server, list it again next time
+        qWarning() << "Downloading Error: Expected" << volume->size << "bytes but got" << file.size() << ": " << filename;
+        file.remove();
+        manifest->remove();
+        co_return false;
+    }
+
+    if (result) {
+        co_return complete();
+    }
+
+    if (file.exists()) {
+        // Lets the next attempt keep the bytes after the last full block
+        file.flush();
+        volume->tail_size = block_fill;
+        volume->tail_hash = block_fill > 0 ? block_hash.result() : 0;
+    }
+    manifest->save();
+    co_return false;
 }
 
-QCoro::Task<bool> HttpDownloader::downloadDir(const QString dir_path)
+QCoro::Task<QList<DownloadManifest::Volume>> HttpDownloader::listDir(const QString dir_path)
 {
     QUrl url = base_url_ + dir_path + "/";
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::UserAgentHeader, "rclone/v1.65.2");
     auto *reply = co_await manager_.get(request);
     auto html = co_await qCoro(reply).readAll();
+    reply->deleteLater();
 
     QDomDocument doc;
     doc.setContent(html);
     auto pre_tag = doc.elementsByTagName("pre");
     if (pre_tag.isEmpty()) {
         qWarning() << "Downloading Error: No pre tag found: " << url;
-        co_return false;
+        co_return {};
     }
 
     QString pre_text = pre_tag.at(0).toElement().text();
@@ -136,23 +262,65 @@ QCoro::Task<bool> HttpDownloader::downloadDir(const QString dir_path)
     */
     QRegularExpression re(R"_(^(../)?([0-9a-z]+\.7z\.\d+)+.*\s+(\d+)$)_");
 
-    long long total_size = 0;
-    QVector<QPair<QString, long long>> files;
+    QRegularExpression checksums_re(R"_(^(../)?([0-9a-z]+\.xxh64)\s)_");
+
+    QList<DownloadManifest::Volume> volumes;
+    QString checksums_name;
     for (const QString &line : lines) {
         QRegularExpressionMatch match = re.match(line);
+        QRegularExpressionMatch checksums_match = checksums_re.match(line);
         if (match.hasMatch()) {
-            QString name = match.captured(2);
-            QString size = match.captured(3);
-            total_size += size.toLongLong();
-            files.push_back({name, size.toLongLong()});
+            volumes.append({match.captured(2), match.captured(3).toLongLong()});
+        } else if (checksums_match.hasMatch()) {
+            checksums_name = checksums_match.captured(2);
         }
     }
 
-    if (files.isEmpty()) {
+    if (volumes.isEmpty()) {
         qWarning() << "Downloading Error: No files found: " << url;
-        co_return false;
+        co_return volumes;
+    }
+
+    // Mirrors may publish the volume hashes in xxhsum format, "<xxh64>  <name>" per line
+    if (!checksums_name.isEmpty()) {
+        QNetworkRequest checksums_request(QUrl(base_url_ + dir_path + "/" + checksums_name));
+        checksums_request.setHeader(QNetworkRequest::UserAgentHeader, "rclone/v1.65.2");
+        auto *checksums_reply = co_await manager_.get(checksums_request);
+        const QString checksums = QString::fromUtf8(co_await qCoro(checksums_reply).readAll());
+        checksums_reply->deleteLater();
+
+        QRegularExpression line_re(R"_(^([0-9a-f]{16})\s+\*?(\S+)$)_", QRegularExpression::MultilineOption);
+        for (auto it = line_re.globalMatch(checksums); it.hasNext();) {
+            const QRegularExpressionMatch match = it.next();
+            for (DownloadManifest::Volume &volume : volumes) {
+                if (volume.name == match.captured(2)) {
+                    volume.expected_xxh64 = match.captured(1);
+                }
+            }
+        }
+    }
+    co_return volumes;
+}
+
+QCoro::Task<bool> HttpDownloader::downloadDir(const QString dir_path)
+{
+    QDir dir(downloadDirectory() + "/" + dir_path);
+    if (!dir.exists()) {
+        dir.mkpath(downloadDirectory() + "/" + dir_path);
     }
 
+    DownloadManifest manifest(dir.absolutePath());
+    if (manifest.load()) {
+        qDebug() << "Resuming from manifest: " << manifest.path();
+    } else {
+        manifest.setVolumes(co_await listDir(dir_path));
+        if (manifest.volumes().isEmpty()) {
+            co_return false;
+        }
+        manifest.save();
+    }
+
+    const long long total_size = manifest.totalSize();
     emit downloadProgressDir(dir_path, 0, total_size);
 
     auto total_received = QSharedPointer<long long>::create(0);
@@ -165,14 +333,12 @@ QCoro::Task<bool> HttpDownloader::downloadDir(const QString dir_path)
                             }
                         });
 
-    QDir dir(downloadDirectory() + "/" + dir_path);
-    if (!dir.exists()) {
-        dir.mkpath(downloadDirectory() + "/" + dir_path);
-    }
-
     bool result = true;
-    for (const auto &[name, size] : files) {
-        if (!co_await download(dir_path + "/" + name)) {
+    for (qsizetype i = 0; i < manifest.volumes().size(); ++i) {
+        // Copied, a failed download may clear the manifest
+        const QString name = manifest.volumes()[i].name;
+        const qint64 size = manifest.volumes()[i].size;
+        if (!co_await download(dir_path + "/" + name, &manifest)) {
             qDebug() << "Download failed: " << dir_path;
             result = false;
             break;
@@ -186,3 +352,69 @@ QCoro::Task<bool> HttpDownloader::downloadDir(const QString dir_path)
     disconnect(conn);
     co_return result;
 }
+
+QCoro::Task<int> HttpDownloader::verifyDir(const QString dir_path)
+{
+    const QString dir = download_directory_ + "/" + dir_path;
+    DownloadManifest manifest(dir);
+    if (!manifest.load()) {
+        co_return -1;
+    }
+
+    // The listing is cheap and catches volumes that were replaced on the server
+    QList<DownloadManifest::Volume> volumes = co_await listDir(dir_path);
+    if (volumes.isEmpty()) {
+        volumes = manifest.volumes();
+    } else {
+        for (DownloadManifest::Volume &volume : volumes) {
+            const DownloadManifest::Volume *recorded = manifest.volume(volume.name);
+            if (recorded && recorded->size == volume.size) {
+                const QString expected_xxh64 = volume.expected_xxh64;
+                volume = *recorded;
+                volume.expected_xxh64 = expected_xxh64;
+            }
+        }
+    }
+
+    QList<bool> bad(volumes.size(), false);
+    co_await runInWorkerThread([&]() {
+        for (qsizetype i = 0; i < volumes.size(); ++i) {
+            const DownloadManifest::Volume &volume = volumes[i];
+            if (!volume.complete) {
+                continue;
+            }
+            // A digest that differs from the server's needs no reading
+            bad[i] = (!volume.xxh64.isEmpty() && !volume.expected_xxh64.isEmpty() && volume.xxh64 != volume.expected_xxh64)
+                || !DownloadManifest::verifyComplete(volume, dir + "/" + volume.name);
+        }
+    });
+
+    int discarded = 0;
+    for (qsizetype i = 0; i < volumes.size(); ++i) {
+        DownloadManifest::Volume &volume = volumes[i];
+        // Also files of volumes that are no longer listed, or whose listed size changed
+        if (bad[i] || (!volume.complete && QFile::exists(dir + "/" + volume.name))) {
+            qWarning() << "Discarding bad volume: " << dir + "/" + volume.name;
+            QFile::remove(dir + "/" + volume.name);
+            QFile::remove(dir + "/" + volume.name + ".tmp");
+            volume.reset();
+            ++discarded;
+        }
+    }
+
+    for (const DownloadManifest::Volume &volume : manifest.volumes()) {
+        bool listed = false;
+        for (const DownloadManifest::Volume &listed_volume : volumes) {
+            listed = listed || listed_volume.name == volume.name;
+        }
+        if (!listed) {
+            QFile::remove(dir + "/" + volume.name);
+            QFile::remove(dir + "/" + volume.name + ".tmp");
+            ++discarded;
+        }
+    }
+
+    manifest.setVolumes(volumes);
+    manifest.save();
+    co_return discarded;
+}
@@ -17,6 +17,7 @@
 
 #ifndef QROOKIE_HTTP_DOWNLOADER
 #define QROOKIE_HTTP_DOWNLOADER
+#include "download_manifest.h"
 #include <QCoroTask>
 #include <QNetworkAccessManager>
 #include <QStack>
@@ -45,8 +46,8 @@ public:
         download_directory_ = directory;
     }
 
-    // Download a file from the server
-    QCoro::Task<bool> download(const QString file_path);
+    // Download a file from the server, volumes of a directory are recorded in its manifest
+    QCoro::Task<bool> download(const QString file_path, DownloadManifest *manifest = nullptr);
     void abortDownload(const QString file_path)
     {
         abort_files_.push(file_path);
@@ -57,12 +58,19 @@ public:
     {
         abort_dirs_.push(dir_path);
     }
+    // Check the downloaded volumes of a directory against the server listing, its hashes and the recorded ones,
+    // and discard the bad ones so the next downloadDir fetches only those again.
+    // Returns the number of volumes discarded, or -1 if there is no manifest to check against.
+    QCoro::Task<int> verifyDir(const QString dir_path);
 
 signals:
     void downloadProgress(QString filename, qint64 bytes_received, qint64 bytes_total);
     void downloadProgressDir(QString dir_name, qint64 bytes_received, qint64 bytes_total);
 
 private:
+    // Volumes in the server's listing of a directory, empty on failure
+    QCoro::Task<QList<DownloadManifest::Volume>> listDir(const QString dir_path);
+
     QNetworkAccessManager manager_;
     QString download_directory_;
     QString base_url_;
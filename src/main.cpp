@@ -26,6 +26,7 @@
 #include "app_settings.h"
 #include "device_manager.h"
 #include "qrookie.h"
+#include "thumbnail_provider.h"
 #include "vrp_manager.h"
 
 int main(int argc, char *argv[])
@@ -82,6 +83,7 @@ int main(int argc, char *argv[])
         QCoro::Qml::registerTypes();
 
         QQmlApplicationEngine engine;
+        engine.addImageProvider("thumbnail", new ThumbnailProvider);
 
 #ifdef MACOS_BUNDLE
         engine.addImportPath(res_dir + "/kirigami");
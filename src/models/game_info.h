@@ -18,7 +18,8 @@
 #pragma once
 #ifndef QROOKIE_GAME_INFO
 #define QROOKIE_GAME_INFO
-class QString;
+#include <QSet>
+#include <QString>
 
 struct GameInfo {
     bool operator==(const GameInfo &other) const
@@ -33,6 +34,23 @@ struct GameInfo {
     QString last_updated;
     QString size;
 
+    // Make the fields that repeat across records (package names, versions, dates and sizes) share one
+    // buffer with every other record holding the same text, e.g. a catalog entry and the installed app.
+    // Records are only built on the gui thread.
+    void intern()
+    {
+        package_name = internString(package_name);
+        version_code = internString(version_code);
+        last_updated = internString(last_updated);
+        size = internString(size);
+    }
+
+    static QString internString(const QString &string)
+    {
+        static QSet<QString> pool;
+        return *pool.insert(string);
+    }
+
     Q_GADGET
     Q_PROPERTY(QString name MEMBER name)
     Q_PROPERTY(QString release_name MEMBER release_name)
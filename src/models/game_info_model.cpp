@@ -18,6 +18,9 @@
 #include "game_info_model.h"
 #include "game_info.h"
 
+#include <QSet>
+#include <algorithm>
+
 GameInfoModel::GameInfoModel(QObject *parent)
     : QAbstractListModel(parent)
 {
@@ -43,7 +46,7 @@ QVariant GameInfoModel::data(const QModelIndex &index, int role) const
         return QVariant();
     }
 
-    auto game_info = games_info_.at(row);
+    const GameInfo &game_info = games_info_.at(row);
     switch (role) {
     case nameRole:
         return game_info.name;
@@ -71,13 +74,7 @@ QHash<int, QByteArray> GameInfoModel::roleNames() const
 
 void GameInfoModel::insert(int index, const GameInfo &game_info)
 {
-    if (index < 0 || index > games_info_.size()) {
-        return;
-    }
-
-    emit beginInsertRows(QModelIndex(), index, index);
-    games_info_.insert(index, game_info);
-    emit endInsertRows();
+    insert(index, QList<GameInfo>{game_info});
 }
 
 void GameInfoModel::prepend(const GameInfo &game_info)
@@ -90,22 +87,48 @@ void GameInfoModel::append(const GameInfo &game_info)
     insert(games_info_.size(), game_info);
 }
 
+void GameInfoModel::insert(int index, const QList<GameInfo> &games)
+{
+    if (index < 0 || index > games_info_.size() || games.isEmpty()) {
+        return;
+    }
+
+    emit beginInsertRows(QModelIndex(), index, index + games.size() - 1);
+    games_info_.insert(index, games.size(), GameInfo{});
+    std::copy(games.begin(), games.end(), games_info_.begin() + index);
+    reindex(index);
+    emit endInsertRows();
+}
+
+void GameInfoModel::append(const QList<GameInfo> &games)
+{
+    insert(games_info_.size(), games);
+}
+
 void GameInfoModel::remove(int index)
 {
-    if (index < 0 || index >= games_info_.size()) {
+    remove(index, 1);
+}
+
+void GameInfoModel::remove(int index, int count)
+{
+    if (index < 0 || count <= 0 || index + count > games_info_.size()) {
         return;
     }
 
-    emit beginRemoveRows(QModelIndex(), index, index);
-    auto game = games_info_.at(index);
-    games_info_.removeAt(index);
-    emit removed(game);
+    emit beginRemoveRows(QModelIndex(), index, index + count - 1);
+    for (int i = index; i < index + count; ++i) {
+        rows_.remove(games_info_[i].release_name);
+        emit removed(games_info_[i]);
+    }
+    games_info_.remove(index, count);
+    reindex(index);
     emit endRemoveRows();
 }
 
 void GameInfoModel::remove(const GameInfo &game_info)
 {
-    int index = games_info_.indexOf(game_info);
+    int index = indexOf(game_info);
     if (index == -1) {
         return;
     }
@@ -113,6 +136,35 @@ void GameInfoModel::remove(const GameInfo &game_info)
     remove(index);
 }
 
+int GameInfoModel::indexOf(const QString &release_name) const
+{
+    return rows_.value(release_name, -1);
+}
+
+int GameInfoModel::indexOf(const GameInfo &game_info) const
+{
+    if (game_info.release_name.isEmpty()) {
+        return games_info_.indexOf(game_info);
+    }
+
+    // The index only holds one row per release name
+    int index = indexOf(game_info.release_name);
+    if (index == -1 || games_info_[index] == game_info) {
+        return index;
+    }
+    return games_info_.indexOf(game_info);
+}
+
+void GameInfoModel::reindex(qsizetype from)
+{
+    // Removed rows are dropped from the index by the caller
+    for (qsizetype i = from; i < games_info_.size(); ++i) {
+        if (!games_info_[i].release_name.isEmpty()) {
+            rows_.insert(games_info_[i].release_name, i);
+        }
+    }
+}
+
 void GameInfoModel::clear()
 {
     if (games_info_.isEmpty()) {
@@ -124,5 +176,74 @@ void GameInfoModel::clear()
         emit removed(game);
     }
     games_info_.clear();
+    rows_.clear();
     emit endRemoveRows();
-}
\ No newline at end of file
+}
+
+QStringList GameInfoModel::syncByPackageName(const QList<GameInfo> &games)
+{
+    QHash<QString, qsizetype> wanted;
+    for (qsizetype i = 0; i < games.size(); ++i) {
+        wanted.insert(games[i].package_name, i);
+    }
+
+    QStringList changed;
+
+    // Drop rows that are gone, one notification per contiguous range
+    for (qsizetype i = games_info_.size() - 1; i >= 0;) {
+        if (wanted.contains(games_info_[i].package_name)) {
+            --i;
+            continue;
+        }
+
+        qsizetype last = i;
+        while (i >= 0 && !wanted.contains(games_info_[i].package_name)) {
+            --i;
+        }
+        qsizetype first = i + 1;
+
+        emit beginRemoveRows(QModelIndex(), first, last);
+        for (qsizetype j = first; j <= last; ++j) {
+            rows_.remove(games_info_[j].release_name);
+            changed.append(games_info_[j].package_name);
+            emit removed(games_info_[j]);
+        }
+        games_info_.remove(first, last - first + 1);
+        reindex(first);
+        emit endRemoveRows();
+    }
+
+    // Update the remaining rows in place
+    QSet<QString> present;
+    for (qsizetype i = 0; i < games_info_.size(); ++i) {
+        const GameInfo &game = games[wanted.value(games_info_[i].package_name)];
+        present.insert(game.package_name);
+        if (!(games_info_[i] == game)) {
+            if (games_info_[i].release_name != game.release_name) {
+                rows_.remove(games_info_[i].release_name);
+                if (!game.release_name.isEmpty()) {
+                    rows_.insert(game.release_name, i);
+                }
+            }
+            games_info_[i] = game;
+            changed.append(game.package_name);
+            emit dataChanged(index(i), index(i));
+        }
+    }
+
+    // Append the new ones in one go
+    QList<GameInfo> added;
+    for (const GameInfo &game : games) {
+        if (!present.contains(game.package_name)) {
+            present.insert(game.package_name);
+            added.append(game);
+            changed.append(game.package_name);
+        }
+    }
+
+    if (!added.isEmpty()) {
+        append(added);
+    }
+
+    return changed;
+}
@@ -21,6 +21,7 @@
 
 #include <QAbstractListModel>
 #include <QList>
+#include <QStringList>
 
 class GameInfo;
 
@@ -47,15 +48,24 @@ public:
     Q_INVOKABLE void remove(const GameInfo &game);
     Q_INVOKABLE void clear();
 
+    // Batch versions, each is a single insert or remove notification
+    void insert(int index, const QList<GameInfo> &games);
+    void append(const QList<GameInfo> &games);
+    void remove(int index, int count);
+
+    // Row of the game with this release name, -1 if there is none
+    int indexOf(const QString &release_name) const;
+
+    // Make the model hold games, matching rows by package name.
+    // Only rows that are actually gone, new or different are touched, returns their package names.
+    QStringList syncByPackageName(const QList<GameInfo> &games);
+
     size_t size() const
     {
         return games_info_.size();
     }
 
-    GameInfo &operator[](size_t index)
-    {
-        return games_info_[index];
-    }
+    // Read only, rows are indexed by release name
     const GameInfo &operator[](size_t index) const
     {
         return games_info_[index];
@@ -71,7 +81,13 @@ protected:
     virtual QHash<int, QByteArray> roleNames() const override;
 
 private:
+    int indexOf(const GameInfo &game) const;
+    // Refresh the row index from row `from` on, after rows were inserted or removed there
+    void reindex(qsizetype from);
+
     QList<GameInfo> games_info_;
+    // Release name -> row, games without a release name (device apps) are not indexed
+    QHash<QString, qsizetype> rows_;
     QHash<int, QByteArray> role_names_;
 };
 
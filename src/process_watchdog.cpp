@@ -0,0 +1,112 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "process_watchdog.h"
+#include "app_settings.h"
+
+#include <QCoroProcess>
+#include <QFile>
+#include <QProcess>
+
+static constexpr int CHECK_INTERVAL_MS = 5000;
+
+ProcessWatchdog::ProcessWatchdog(QProcess *process, int stall_timeout_ms)
+    : process_(process)
+    , stall_timeout_ms_(stall_timeout_ms > 0 ? stall_timeout_ms : AppSettings::instance()->stallTimeout() * 1000)
+    , stalled_(false)
+    , last_io_counter_(-1)
+{
+    connect(process_, &QProcess::readyReadStandardOutput, this, &ProcessWatchdog::reportProgress);
+    connect(process_, &QProcess::readyReadStandardError, this, &ProcessWatchdog::reportProgress);
+    connect(process_, &QProcess::bytesWritten, this, &ProcessWatchdog::reportProgress);
+    connect(process_, &QProcess::started, this, &ProcessWatchdog::reportProgress);
+    connect(&check_timer_, &QTimer::timeout, this, &ProcessWatchdog::check);
+
+    last_progress_.start();
+    if (stall_timeout_ms_ > 0) {
+        check_timer_.start(qMin(CHECK_INTERVAL_MS, stall_timeout_ms_));
+    }
+}
+
+QCoro::Task<bool> ProcessWatchdog::waitForFinished(QProcess &process, int stall_timeout_ms)
+{
+    ProcessWatchdog watchdog(&process, stall_timeout_ms);
+    co_await qCoro(process).waitForFinished(-1);
+    co_return !watchdog.stalled();
+}
+
+void ProcessWatchdog::reportProgress()
+{
+    last_progress_.restart();
+}
+
+void ProcessWatchdog::check()
+{
+    if (process_->state() != QProcess::Running) {
+        last_io_counter_ = -1;
+        reportProgress();
+        return;
+    }
+
+    qint64 io_counter = ioCounter();
+    if (io_counter != last_io_counter_) {
+        last_io_counter_ = io_counter;
+        reportProgress();
+        return;
+    }
+
+    if (last_progress_.elapsed() >= stall_timeout_ms_) {
+        qWarning() << process_->program() << process_->arguments() << "made no progress for" << last_progress_.elapsed() / 1000 << "seconds, killing it";
+        stalled_ = true;
+        process_->kill();
+    }
+}
+
+bool ProcessWatchdog::watchesIo()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+qint64 ProcessWatchdog::ioCounter() const
+{
+#ifdef Q_OS_LINUX
+    /* EXAMPLE OUTPUT:
+        rchar: 323934931
+        wchar: 323929600
+        syscr: 632687
+        ...
+    */
+    QFile file(QString("/proc/%1/io").arg(process_->processId()));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    qint64 counter = 0;
+    for (const QByteArray &line : file.readAll().split('\n')) {
+        if (line.startsWith("rchar:") || line.startsWith("wchar:")) {
+            counter += line.mid(6).trimmed().toLongLong();
+        }
+    }
+    return counter;
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,67 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_PROCESS_WATCHDOG
+#define QROOKIE_PROCESS_WATCHDOG
+
+#include <QCoroTask>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+class QProcess;
+
+// Kills a process that made no progress for a while. Progress is any output, any of its stdin
+// being consumed and, where the system reports it, any I/O of the process itself, so quiet but
+// busy processes like adb push or 7za x are not mistaken for stalled ones.
+class ProcessWatchdog : public QObject
+{
+    Q_OBJECT
+
+public:
+    // A timeout of 0 uses the stall timeout from the settings, where 0 turns the watchdog off
+    explicit ProcessWatchdog(QProcess *process, int stall_timeout_ms = 0);
+
+    // The process was killed by the watchdog
+    bool stalled() const
+    {
+        return stalled_;
+    }
+
+    // For callers that keep a process busy on purpose, e.g. while it is paused because its output is not consumed fast enough
+    void reportProgress();
+
+    // Wait until the process finishes, false if it was killed because it stalled
+    static QCoro::Task<bool> waitForFinished(QProcess &process, int stall_timeout_ms = 0);
+
+    // Whether the I/O of a process counts as progress on this system, otherwise only its output and stdin do
+    static bool watchesIo();
+
+private:
+    void check();
+    qint64 ioCounter() const;
+
+    QProcess *process_;
+    int stall_timeout_ms_;
+    bool stalled_;
+    qint64 last_io_counter_;
+    QElapsedTimer last_progress_;
+    QTimer check_timer_;
+};
+
+#endif /* QROOKIE_PROCESS_WATCHDOG */
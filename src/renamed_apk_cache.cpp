@@ -0,0 +1,190 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "renamed_apk_cache.h"
+#include "app_settings.h"
+#include "worker_thread.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <algorithm>
+
+RenamedApkCache::RenamedApkCache()
+    : hashes_loaded_(false)
+{
+}
+
+QCoro::Task<QString> RenamedApkCache::key(const QString apk_path, const QString new_package_name, const QString keystore_path)
+{
+    loadHashes();
+
+    QFileInfo apk_info(apk_path);
+    const QString path = apk_info.absoluteFilePath();
+    QJsonObject cached = hashes_.value(path).toObject();
+
+    QByteArray apk_hash;
+    if (cached.value("size").toInteger() == apk_info.size() && cached.value("modified").toInteger() == apk_info.lastModified().toMSecsSinceEpoch()) {
+        apk_hash = QByteArray::fromHex(cached.value("sha256").toString().toLatin1());
+    } else {
+        apk_hash = co_await fileHash(path);
+        if (apk_hash.isEmpty()) {
+            co_return {};
+        }
+
+        hashes_[path] = QJsonObject{{"size", apk_info.size()},
+                                    {"modified", apk_info.lastModified().toMSecsSinceEpoch()},
+                                    {"sha256", QString::fromLatin1(apk_hash.toHex())}};
+        saveHashes();
+    }
+
+    QByteArray keystore_hash = co_await fileHash(keystore_path);
+    if (keystore_hash.isEmpty()) {
+        co_return {};
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(apk_hash);
+    hash.addData(new_package_name.toUtf8());
+    hash.addData(keystore_hash);
+    co_return QString::fromLatin1(hash.result().toHex());
+}
+
+QString RenamedApkCache::lookup(const QString &key, const QString &new_package_name)
+{
+    const QString path = cacheDir() + "/" + key + "/" + new_package_name + ".apk";
+    QFile file(path);
+    if (!file.exists()) {
+        return {};
+    }
+
+    // Mark as recently used
+    if (file.open(QIODevice::ReadWrite)) {
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+    return path;
+}
+
+QString RenamedApkCache::insert(const QString &key, const QString &new_package_name, const QString &renamed_apk_path)
+{
+    const QString entry_dir = cacheDir() + "/" + key;
+    const QString path = entry_dir + "/" + new_package_name + ".apk";
+
+    QDir().mkpath(entry_dir);
+    QFile::remove(path);
+    if (!QFile::rename(renamed_apk_path, path) && !QFile::copy(renamed_apk_path, path)) {
+        qWarning() << "Failed to cache" << renamed_apk_path;
+        return renamed_apk_path;
+    }
+    QFile::remove(renamed_apk_path);
+
+    QFile file(path);
+    if (file.open(QIODevice::ReadWrite)) {
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    }
+
+    evict();
+    return path;
+}
+
+QString RenamedApkCache::cacheDir() const
+{
+    return AppSettings::instance()->cachePath() + "/renamed_apks";
+}
+
+QCoro::Task<QByteArray> RenamedApkCache::fileHash(const QString file_path)
+{
+    // Source apks are up to several GB, don't block the ui while hashing
+    QByteArray result;
+    co_await runInWorkerThread([&]() {
+        QFile file(file_path);
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        if (file.open(QIODevice::ReadOnly) && hash.addData(&file)) {
+            result = hash.result();
+        }
+    });
+
+    if (result.isEmpty()) {
+        qWarning() << "Failed to hash" << file_path;
+    }
+    co_return result;
+}
+
+void RenamedApkCache::loadHashes()
+{
+    if (hashes_loaded_) {
+        return;
+    }
+    hashes_loaded_ = true;
+
+    QFile file(cacheDir() + "/hashes.json");
+    if (file.open(QIODevice::ReadOnly)) {
+        hashes_ = QJsonDocument::fromJson(file.readAll()).object();
+    }
+}
+
+void RenamedApkCache::saveHashes()
+{
+    // Forget apks that were deleted since
+    for (auto it = hashes_.begin(); it != hashes_.end();) {
+        if (QFile::exists(it.key())) {
+            ++it;
+        } else {
+            it = hashes_.erase(it);
+        }
+    }
+
+    QDir().mkpath(cacheDir());
+    QFile file(cacheDir() + "/hashes.json");
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to save" << file.fileName();
+        return;
+    }
+    file.write(QJsonDocument(hashes_).toJson(QJsonDocument::Compact));
+}
+
+void RenamedApkCache::evict()
+{
+    const qint64 max_size = qint64(AppSettings::instance()->renamedApkCacheSize()) * 1024 * 1024;
+
+    QFileInfoList entries;
+    for (const QFileInfo &dir : QDir(cacheDir()).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFileInfoList apks = QDir(dir.absoluteFilePath()).entryInfoList({"*.apk"}, QDir::Files);
+        if (apks.isEmpty()) {
+            QDir(dir.absoluteFilePath()).removeRecursively();
+        } else {
+            entries.append(apks.first());
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const QFileInfo &a, const QFileInfo &b) {
+        return a.lastModified() > b.lastModified();
+    });
+
+    // The most recently used entry always stays, even if it alone is over the limit
+    qint64 total_size = 0;
+    for (int i = 0; i < entries.size(); ++i) {
+        total_size += entries[i].size();
+        if (i > 0 && total_size > max_size) {
+            qDebug() << "Evicting renamed apk" << entries[i].absoluteFilePath();
+            QDir(entries[i].absolutePath()).removeRecursively();
+        }
+    }
+}
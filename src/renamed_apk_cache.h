@@ -0,0 +1,55 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_RENAMED_APK_CACHE
+#define QROOKIE_RENAMED_APK_CACHE
+
+#include <QCoroTask>
+#include <QJsonObject>
+#include <QString>
+
+// Renamed and signed apks, keyed by the content of the source apk, the new package name and the keystore.
+// Entries live in <cache path>/renamed_apks/<key>/<new package name>.apk,
+// the modification time of an entry is its last use and the least recently used ones are evicted first.
+class RenamedApkCache
+{
+public:
+    RenamedApkCache();
+
+    // Empty if the source apk or the keystore can't be read
+    QCoro::Task<QString> key(const QString apk_path, const QString new_package_name, const QString keystore_path);
+
+    // Path of the cached apk, or an empty string on a miss
+    QString lookup(const QString &key, const QString &new_package_name);
+
+    // Move a freshly renamed apk into the cache and return its new path
+    QString insert(const QString &key, const QString &new_package_name, const QString &renamed_apk_path);
+
+private:
+    QString cacheDir() const;
+    QCoro::Task<QByteArray> fileHash(const QString file_path);
+    void loadHashes();
+    void saveHashes();
+    void evict();
+
+    // Hashes of source apks by path, reused as long as size and modification time match
+    QJsonObject hashes_;
+    bool hashes_loaded_;
+};
+
+#endif /* QROOKIE_RENAMED_APK_CACHE */
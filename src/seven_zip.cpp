@@ -0,0 +1,115 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "seven_zip.h"
+#include "process_watchdog.h"
+
+#include <QCoroProcess>
+#include <QProcess>
+
+const QString P7ZA("7za");
+
+QString SevenZip::program()
+{
+    return P7ZA;
+}
+
+QCoro::Task<QList<ArchiveEntry>> SevenZip::list(const QString archive_path, const QString password)
+{
+    QProcess basic_process;
+    auto p7za = qCoro(basic_process);
+    p7za.start(P7ZA, {"l", "-slt", QString("-p%1").arg(password), archive_path});
+    co_await ProcessWatchdog::waitForFinished(basic_process);
+
+    if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
+        qWarning("List archive failed: %s\n %s", basic_process.readAllStandardOutput().data(), basic_process.readAllStandardError().data());
+        co_return {};
+    }
+
+    /* EXAMPLE OUTPUT:
+        ...
+        ----------
+        Path = Beat Saber v1.34.2+1.34.2_1003 -VRP/com.beatgames.beatsaber.apk
+        Size = 264436712
+        Packed Size = 261980413
+        Modified = 2024-01-11 08:43:38
+        Attributes = A_ -rw-r--r--
+        CRC = 3D5A8B0C
+        Encrypted = +
+        Method = LZMA2:24 7zAES
+        Block = 0
+
+        Path = Beat Saber v1.34.2+1.34.2_1003 -VRP
+        ...
+        Attributes = D_ drwxr-xr-x
+    */
+    QList<ArchiveEntry> entries;
+    ArchiveEntry entry;
+    bool in_entries = false;
+    const QStringList lines = QString::fromUtf8(basic_process.readAllStandardOutput()).split("\n");
+    for (QString line : lines) {
+        line = line.trimmed();
+
+        // The entries follow the archive properties after a line of dashes
+        if (!in_entries) {
+            in_entries = line == "----------";
+            continue;
+        }
+
+        if (line.isEmpty()) {
+            if (!entry.path.isEmpty()) {
+                entries.append(entry);
+            }
+            entry = ArchiveEntry();
+            continue;
+        }
+
+        int separator = line.indexOf(" = ");
+        QString key = separator < 0 ? line : line.left(separator);
+        QString value = separator < 0 ? QString() : line.mid(separator + 3);
+        if (key == "Path") {
+            entry.path = value;
+        } else if (key == "Size") {
+            entry.size = value.toLongLong();
+        } else if (key == "CRC") {
+            entry.crc = value;
+        } else if (key == "Folder") {
+            entry.is_dir = value == "+";
+        } else if (key == "Attributes") {
+            entry.is_dir = entry.is_dir || value.startsWith('D');
+        }
+    }
+
+    if (!entry.path.isEmpty()) {
+        entries.append(entry);
+    }
+    co_return entries;
+}
+
+qint64 SevenZip::unpackedSize(const QList<ArchiveEntry> &entries)
+{
+    qint64 size = 0;
+    for (const auto &entry : entries) {
+        size += entry.size;
+    }
+    return size;
+}
+
+void SevenZip::startExtractToStdout(QProcess &process, const QString &archive_path, const QString &password)
+{
+    process.start(P7ZA, {"x", "-so", QString("-p%1").arg(password), archive_path});
+}
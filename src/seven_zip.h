@@ -0,0 +1,50 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_SEVEN_ZIP
+#define QROOKIE_SEVEN_ZIP
+
+#include <QCoroTask>
+#include <QList>
+#include <QString>
+
+class QProcess;
+
+struct ArchiveEntry {
+    QString path;
+    qint64 size = 0;
+    QString crc;
+    bool is_dir = false;
+};
+
+class SevenZip
+{
+public:
+    static QString program();
+
+    // List the entries of an archive in the order they are stored
+    static QCoro::Task<QList<ArchiveEntry>> list(const QString archive_path, const QString password);
+
+    // Sum of the uncompressed sizes of all files
+    static qint64 unpackedSize(const QList<ArchiveEntry> &entries);
+
+    // Start extracting every file of the archive to stdout, files are written back to back in archive order
+    static void startExtractToStdout(QProcess &process, const QString &archive_path, const QString &password);
+};
+
+#endif /* QROOKIE_SEVEN_ZIP */
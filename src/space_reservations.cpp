@@ -0,0 +1,110 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "space_reservations.h"
+#include "worker_thread.h"
+
+#include <QCoroSignal>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <chrono>
+
+// Room left for everything else writing to the same disk
+static constexpr qint64 SAFETY_MARGIN = 512 * 1024 * 1024;
+
+SpaceReservations::SpaceReservations(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QCoro::Task<bool> SpaceReservations::reserve(const QString key, const QString dir, qint64 bytes)
+{
+    Reservation reservation{QStorageInfo(existingPath(dir)).rootPath(), dir, bytes};
+
+    while (true) {
+        QList<Reservation> others;
+        for (auto it = reservations_.cbegin(); it != reservations_.cend(); ++it) {
+            if (it.key() != key && it->root == reservation.root) {
+                others.append(*it);
+            }
+        }
+
+        // An extraction writes thousands of files into its directory, don't walk them on the gui thread
+        qint64 needed = 0;
+        qint64 held = 0;
+        co_await runInWorkerThread([&]() {
+            needed = outstanding(reservation) + SAFETY_MARGIN;
+            for (const Reservation &other : others) {
+                held += outstanding(other);
+            }
+        });
+
+        QStorageInfo storage(existingPath(dir));
+        const qint64 available = storage.bytesAvailable();
+
+        if (!storage.isValid() || available < 0) {
+            // Unknown, let the job find out by itself
+            break;
+        }
+
+        if (needed > available) {
+            qWarning() << "Not enough space in" << storage.rootPath() << "for" << key << ", need" << needed << "bytes, have" << available;
+            co_return false;
+        }
+
+        if (needed <= available - held) {
+            break;
+        }
+
+        // Space freed outside of QRookie is only noticed when polling
+        qDebug() << "Waiting for" << held << "reserved bytes in" << storage.rootPath() << "before" << key;
+        co_await qCoro(this, &SpaceReservations::released, std::chrono::seconds(30));
+    }
+
+    reservations_.insert(key, reservation);
+    co_return true;
+}
+
+void SpaceReservations::release(const QString &key)
+{
+    if (reservations_.remove(key)) {
+        emit released();
+    }
+}
+
+QString SpaceReservations::existingPath(const QString &dir)
+{
+    // The directory is only created once the job starts writing
+    QFileInfo existing(dir);
+    while (!existing.exists() && !existing.isRoot()) {
+        existing = QFileInfo(existing.absolutePath());
+    }
+    return existing.absoluteFilePath();
+}
+
+qint64 SpaceReservations::outstanding(const Reservation &reservation)
+{
+    qint64 written = 0;
+    QDirIterator it(reservation.dir, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        written += it.fileInfo().size();
+    }
+    return qMax<qint64>(0, reservation.bytes - written);
+}
@@ -0,0 +1,59 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_SPACE_RESERVATIONS
+#define QROOKIE_SPACE_RESERVATIONS
+
+#include <QCoroTask>
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+// Host disk space promised to jobs that are about to write, so that two multi GB jobs don't pass
+// the same free space check. A reservation covers the files a job writes into its directory,
+// what is already in there counts as used up and no longer as reserved.
+class SpaceReservations : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SpaceReservations(QObject *parent = nullptr);
+
+    // Reserve bytes for files written into dir. Waits while other jobs hold the space it needs,
+    // false right away if the volume is too small even once all of them are done.
+    QCoro::Task<bool> reserve(const QString key, const QString dir, qint64 bytes);
+    void release(const QString &key);
+
+signals:
+    void released();
+
+private:
+    struct Reservation {
+        QString root;
+        QString dir;
+        qint64 bytes = 0;
+    };
+
+    static QString existingPath(const QString &dir);
+    // Walks the directory of the reservation, call it off the gui thread
+    static qint64 outstanding(const Reservation &reservation);
+
+    QHash<QString, Reservation> reservations_;
+};
+
+#endif /* QROOKIE_SPACE_RESERVATIONS */
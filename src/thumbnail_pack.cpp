@@ -0,0 +1,152 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thumbnail_pack.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QtEndian>
+
+static constexpr char MAGIC[] = "QRTHUMB1";
+static constexpr qint64 MAGIC_SIZE = 8;
+static constexpr qint64 HEADER_SIZE = MAGIC_SIZE + 4 + 4 + 8;
+
+template<typename T>
+static void writeLittleEndian(QIODevice &device, T value)
+{
+    char buffer[sizeof(T)];
+    qToLittleEndian<T>(value, buffer);
+    device.write(buffer, sizeof(T));
+}
+
+bool ThumbnailPack::build(const QString &source_dir, const QString &pack_path, int width)
+{
+    QDir dir(source_dir);
+    const QStringList jpgs = dir.entryList({"*.jpg"}, QDir::Files, QDir::Name);
+    if (jpgs.isEmpty()) {
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(pack_path).path());
+    QSaveFile file(pack_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to create" << pack_path;
+        return false;
+    }
+
+    // The header is completed once the index is written
+    file.write(QByteArray(HEADER_SIZE, '\0'));
+
+    QByteArray index;
+    QBuffer index_buffer(&index);
+    index_buffer.open(QIODevice::WriteOnly);
+    quint32 count = 0;
+    for (const QString &jpg : jpgs) {
+        QImageReader reader(dir.filePath(jpg));
+        const QSize source_size = reader.size();
+        if (source_size.width() > width) {
+            reader.setScaledSize(source_size.scaled(width, source_size.height(), Qt::KeepAspectRatio));
+        }
+
+        QImage image = reader.read();
+        QByteArray data;
+        QBuffer buffer(&data);
+        if (image.isNull() || !buffer.open(QIODevice::WriteOnly) || !image.save(&buffer, "JPG", 90)) {
+            qWarning() << "Failed to pack thumbnail" << jpg << reader.errorString();
+            continue;
+        }
+
+        const QByteArray name = QFileInfo(jpg).completeBaseName().toUtf8();
+        writeLittleEndian<quint16>(index_buffer, name.size());
+        index_buffer.write(name);
+        writeLittleEndian<quint64>(index_buffer, file.pos());
+        writeLittleEndian<quint32>(index_buffer, data.size());
+        file.write(data);
+        ++count;
+    }
+
+    const quint64 index_offset = file.pos();
+    file.write(index);
+
+    file.seek(0);
+    file.write(MAGIC, MAGIC_SIZE);
+    writeLittleEndian<quint32>(file, width);
+    writeLittleEndian<quint32>(file, count);
+    writeLittleEndian<quint64>(file, index_offset);
+
+    if (!file.commit()) {
+        qWarning() << "Failed to write" << pack_path;
+        return false;
+    }
+    qDebug() << "Packed" << count << "thumbnails into" << pack_path;
+    return true;
+}
+
+bool ThumbnailPack::open(const QString &pack_path)
+{
+    file_.setFileName(pack_path);
+    if (!file_.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    size_ = file_.size();
+    data_ = size_ >= HEADER_SIZE ? file_.map(0, size_) : nullptr;
+    if (!data_ || QByteArray::fromRawData(reinterpret_cast<const char *>(data_), MAGIC_SIZE) != MAGIC) {
+        qWarning() << "Invalid thumbnail pack" << pack_path;
+        return false;
+    }
+
+    width_ = qFromLittleEndian<quint32>(data_ + MAGIC_SIZE);
+    const quint32 count = qFromLittleEndian<quint32>(data_ + MAGIC_SIZE + 4);
+    qint64 pos = qFromLittleEndian<quint64>(data_ + MAGIC_SIZE + 8);
+
+    index_.reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+        if (pos < HEADER_SIZE || pos + 2 > size_) {
+            break;
+        }
+        const quint16 name_size = qFromLittleEndian<quint16>(data_ + pos);
+        if (pos + 2 + name_size + 12 > size_) {
+            break;
+        }
+
+        const QString name = QString::fromUtf8(reinterpret_cast<const char *>(data_ + pos + 2), name_size);
+        const qint64 offset = qFromLittleEndian<quint64>(data_ + pos + 2 + name_size);
+        const qint64 length = qFromLittleEndian<quint32>(data_ + pos + 2 + name_size + 8);
+        if (offset >= HEADER_SIZE && offset + length <= size_) {
+            index_.insert(name, {offset, length});
+        }
+        pos += 2 + name_size + 12;
+    }
+
+    if (index_.size() != qsizetype(count)) {
+        qWarning() << "Thumbnail pack" << pack_path << "is truncated";
+    }
+    return true;
+}
+
+QByteArray ThumbnailPack::image(const QString &package_name) const
+{
+    auto it = index_.constFind(package_name);
+    if (it == index_.cend()) {
+        return {};
+    }
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(data_ + it->first), it->second);
+}
@@ -0,0 +1,54 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_THUMBNAIL_PACK
+#define QROOKIE_THUMBNAIL_PACK
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+
+// Pre-scaled thumbnails of all games in one file, mapped into memory so a lookup costs no syscalls.
+// Layout, integers are little endian:
+//   "QRTHUMB1" | u32 width | u32 count | u64 index offset | jpg data... | count * (u16 name size | name | u64 offset | u32 size)
+class ThumbnailPack
+{
+public:
+    // Scale every <package name>.jpg in source_dir down to width and pack them
+    static bool build(const QString &source_dir, const QString &pack_path, int width);
+
+    bool open(const QString &pack_path);
+
+    int width() const
+    {
+        return width_;
+    }
+
+    // Jpg data pointing into the mapped file, empty if the package has no thumbnail.
+    // Only valid as long as the pack is open.
+    QByteArray image(const QString &package_name) const;
+
+private:
+    QFile file_;
+    const uchar *data_ = nullptr;
+    qint64 size_ = 0;
+    int width_ = 0;
+    QHash<QString, QPair<qint64, qint64>> index_;
+};
+
+#endif /* QROOKIE_THUMBNAIL_PACK */
@@ -0,0 +1,223 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thumbnail_provider.h"
+#include "app_settings.h"
+#include "thumbnail_pack.h"
+
+#include <QBuffer>
+#include <QCache>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMutex>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSharedPointer>
+
+static constexpr qsizetype MEMORY_CACHE_SIZE = 64 * 1024 * 1024;
+static const QString FALLBACK_IMAGE(":/qt/qml/content/Image/matrix.png");
+
+static QMutex memory_cache_mutex;
+static QCache<QString, QImage> memory_cache(MEMORY_CACHE_SIZE);
+static QSharedPointer<ThumbnailPack> current_pack;
+
+static QSharedPointer<ThumbnailPack> currentPack()
+{
+    QMutexLocker locker(&memory_cache_mutex);
+    return current_pack;
+}
+
+// Target size for a source of source_size, never bigger than the source
+static QSize targetSize(const QSize &source_size, const QSize &size)
+{
+    if (!source_size.isValid()) {
+        return {};
+    }
+    QSize target = source_size.scaled(size.width() > 0 ? size.width() : source_size.width(),
+                                      size.height() > 0 ? size.height() : source_size.height(),
+                                      size.width() > 0 && size.height() > 0 ? Qt::KeepAspectRatioByExpanding : Qt::KeepAspectRatio);
+    return target.width() < source_size.width() ? target : source_size;
+}
+
+class ThumbnailResponse : public QQuickImageResponse, public QRunnable
+{
+public:
+    ThumbnailResponse(const QString &id, const QString &source_dir, const QString &cache_dir, const QSize &requested_size)
+        : id_(id)
+        , source_dir_(source_dir)
+        , cache_dir_(cache_dir)
+        , requested_size_(requested_size)
+    {
+        // Owned by the engine
+        setAutoDelete(false);
+    }
+
+    QQuickTextureFactory *textureFactory() const override
+    {
+        return QQuickTextureFactory::textureFactoryForImage(image_);
+    }
+
+    void run() override
+    {
+        image_ = load();
+        emit finished();
+    }
+
+private:
+    QImage load() const
+    {
+        QSize size = requested_size_;
+        if (size.width() <= 0 && size.height() <= 0) {
+            size.setWidth(ThumbnailProvider::PACK_WIDTH);
+        }
+        const QString size_key = QString("%1x%2").arg(qMax(0, size.width())).arg(qMax(0, size.height()));
+        const QString key = id_ + "@" + size_key;
+
+        {
+            QMutexLocker locker(&memory_cache_mutex);
+            if (QImage *image = memory_cache.object(key)) {
+                return *image;
+            }
+        }
+
+        QImage image = loadFromPack(size);
+        if (!image.isNull()) {
+            QMutexLocker locker(&memory_cache_mutex);
+            memory_cache.insert(key, new QImage(image), image.sizeInBytes());
+            return image;
+        }
+
+        // Ids come from qml, only accept plain package names
+        QString source_path = source_dir_ + "/" + id_ + ".jpg";
+        if (id_.isEmpty() || QFileInfo(id_).fileName() != id_ || !QFileInfo::exists(source_path)) {
+            source_path = FALLBACK_IMAGE;
+        }
+
+        // Keyed on the size and modification time of the source, 7za restores the archive times so a replaced
+        // thumbnail can be older than the copy scaled from the one it replaced
+        const QFileInfo source_info(source_path);
+        const QString scaled_path = cache_dir_ + "/" + size_key + "/" + (source_path == FALLBACK_IMAGE ? QString("fallback") : id_)
+            + QString("-%1-%2.jpg").arg(source_info.size(), 0, 16).arg(source_info.lastModified().toMSecsSinceEpoch(), 0, 16);
+        if (QFileInfo::exists(scaled_path)) {
+            image.load(scaled_path);
+        }
+
+        if (image.isNull()) {
+            // The jpeg decoder scales while decoding, much cheaper than decoding at full size
+            QImageReader reader(source_path);
+            const QSize target = targetSize(reader.size(), size);
+            if (target.isValid() && target != reader.size()) {
+                reader.setScaledSize(target);
+            }
+            image = reader.read();
+            if (image.isNull()) {
+                qWarning() << "Failed to decode thumbnail" << source_path << reader.errorString();
+                return image;
+            }
+
+            QDir().mkpath(QFileInfo(scaled_path).path());
+            QSaveFile file(scaled_path);
+            if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "JPG", 90) || !file.commit()) {
+                qWarning() << "Failed to cache thumbnail" << scaled_path;
+            }
+        }
+
+        QMutexLocker locker(&memory_cache_mutex);
+        memory_cache.insert(key, new QImage(image), image.sizeInBytes());
+        return image;
+    }
+
+    // Null if the pack doesn't have the thumbnail at least at the requested size
+    QImage loadFromPack(const QSize &size) const
+    {
+        auto pack = currentPack();
+        if (!pack) {
+            return {};
+        }
+
+        QByteArray data = pack->image(id_);
+        if (data.isEmpty()) {
+            return {};
+        }
+
+        // Decoded straight from the mapped file
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer, "jpg");
+        const QSize source_size = reader.size();
+        const QSize target = targetSize(source_size, size);
+
+        // Packed thumbnails narrower than the pack are the originals, nothing bigger exists
+        const bool downscaled = source_size.width() >= pack->width();
+        const bool big_enough = (size.width() <= 0 || size.width() <= source_size.width()) && (size.height() <= 0 || size.height() <= source_size.height());
+        if (!target.isValid() || (downscaled && !big_enough)) {
+            return {};
+        }
+
+        if (target != source_size) {
+            reader.setScaledSize(target);
+        }
+        return reader.read();
+    }
+
+    QString id_;
+    QString source_dir_;
+    QString cache_dir_;
+    QSize requested_size_;
+    QImage image_;
+};
+
+ThumbnailProvider::ThumbnailProvider()
+    : source_dir_(AppSettings::instance()->dataPath() + "/.meta/thumbnails")
+    , cache_dir_(AppSettings::instance()->cachePath() + "/thumbnails")
+{
+    reloadPack();
+}
+
+QQuickImageResponse *ThumbnailProvider::requestImageResponse(const QString &id, const QSize &requested_size)
+{
+    auto response = new ThumbnailResponse(id, source_dir_, cache_dir_, requested_size);
+    pool_.start(response);
+    return response;
+}
+
+QString ThumbnailProvider::packPath()
+{
+    return AppSettings::instance()->cachePath() + "/thumbnails/thumbnails.pack";
+}
+
+void ThumbnailProvider::clearScaledCopies()
+{
+    const QString cache_dir = AppSettings::instance()->cachePath() + "/thumbnails";
+    for (const QString &size_dir : QDir(cache_dir).entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QDir(cache_dir + "/" + size_dir).removeRecursively();
+    }
+}
+
+void ThumbnailProvider::reloadPack()
+{
+    auto pack = QSharedPointer<ThumbnailPack>::create();
+    if (!pack->open(packPath())) {
+        pack.reset();
+    }
+
+    // Responses still decoding keep the previous pack mapped until they are done
+    QMutexLocker locker(&memory_cache_mutex);
+    current_pack = pack;
+    memory_cache.clear();
+}
@@ -0,0 +1,52 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_THUMBNAIL_PROVIDER
+#define QROOKIE_THUMBNAIL_PROVIDER
+
+#include <QQuickAsyncImageProvider>
+#include <QThreadPool>
+
+// image://thumbnail/<package name>
+// Decodes game thumbnails at the requested size on worker threads. Decoded images are kept in a
+// memory LRU. They are read from the thumbnail pack when it has them big enough, otherwise from
+// the original jpgs, with scaled copies kept in <cache path>/thumbnails.
+class ThumbnailProvider : public QQuickAsyncImageProvider
+{
+public:
+    ThumbnailProvider();
+
+    QQuickImageResponse *requestImageResponse(const QString &id, const QSize &requested_size) override;
+
+    // Width of the thumbnails in the pack, the width of the grid cells in the games tab
+    static constexpr int PACK_WIDTH = 300;
+    static QString packPath();
+
+    // Switch to the thumbnail pack currently on disk, if any, and forget decoded thumbnails
+    static void reloadPack();
+
+    // Remove the scaled copies of the jpgs, they belong to the metadata they were scaled from
+    static void clearScaledCopies();
+
+private:
+    QThreadPool pool_;
+    QString source_dir_;
+    QString cache_dir_;
+};
+
+#endif /* QROOKIE_THUMBNAIL_PROVIDER */
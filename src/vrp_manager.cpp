@@ -16,16 +16,27 @@
  */
 
 #include "vrp_manager.h"
+#include "extraction_manifest.h"
+#include "process_watchdog.h"
+#include "seven_zip.h"
+#include "thumbnail_pack.h"
+#include "thumbnail_provider.h"
+#include "worker_thread.h"
 
 #include <QCoroTimer>
+#include <QDateTime>
 #include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
 #include <QGuiApplication>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QProcess>
+#include <QSaveFile>
 #include <QSharedPointer>
 #include <QStandardPaths>
+#include <algorithm>
 
 #include "qrookie.h"
 
@@ -37,6 +48,9 @@ const QString OPEN_CMD("xdg-open");
 
 const QString P7ZA("7za");
 
+// Journal entries before they are folded into games_info.json
+static constexpr int JOURNAL_COMPACT_ENTRIES = 256;
+
 VrpManager::VrpManager(QObject *parent)
     : QObject(parent)
     , status_filter_(Status::Unknown)
@@ -47,6 +61,12 @@ VrpManager::VrpManager(QObject *parent)
     , device_manager_(new DeviceManager(this))
     , cache_path_(AppSettings::instance()->cachePath())
     , data_path_(AppSettings::instance()->dataPath())
+    , device_connected_(false)
+    , enforcing_quotas_(false)
+    , enforce_quotas_again_(false)
+    , building_thumbnail_pack_(false)
+    , build_thumbnail_pack_again_(false)
+    , journal_entries_(0)
 {
     http_downloader_.setDownloadDirectory(cache_path_);
 
@@ -62,6 +82,14 @@ VrpManager::VrpManager(QObject *parent)
     if (all_games_.key(Status::Queued) != GameInfo{}) {
         downloadQueuedGames();
     }
+
+    if (!QFile::exists(ThumbnailProvider::packPath())) {
+        buildThumbnailPack();
+    }
+
+    connect(settings(), &AppSettings::cacheQuotaChanged, this, &VrpManager::enforceQuotas);
+    connect(settings(), &AppSettings::dataQuotaChanged, this, &VrpManager::enforceQuotas);
+    enforceQuotas();
 }
 
 VrpManager::~VrpManager()
@@ -72,6 +100,7 @@ VrpManager::~VrpManager()
 QVariantList VrpManager::gamesInfo() const
 {
     QList<GameInfo> games;
+    games.reserve(all_games_.size());
 
     for (auto it = all_games_.constBegin(); it != all_games_.constEnd(); ++it) {
         QString name = it.key().name;
@@ -106,6 +135,7 @@ QVariantList VrpManager::gamesInfo() const
     });
 
     QVariantList list;
+    list.reserve(games.size());
     for (auto &game : games) {
         list.append(QVariant::fromValue(game));
     }
@@ -157,6 +187,7 @@ QCoro::Task<bool> VrpManager::downloadMetadata()
             co_return false;
         } else {
             qDebug() << "meta.7z decompression successful";
+            buildThumbnailPack();
             co_return true;
         }
     } else {
@@ -165,6 +196,43 @@ QCoro::Task<bool> VrpManager::downloadMetadata()
     }
 }
 
+QCoro::Task<void> VrpManager::buildThumbnailPack()
+{
+    // Metadata refreshed during a build needs another one
+    if (building_thumbnail_pack_) {
+        build_thumbnail_pack_again_ = true;
+        co_return;
+    }
+    building_thumbnail_pack_ = true;
+
+    do {
+        build_thumbnail_pack_again_ = false;
+
+        // Until the new pack is ready thumbnails are read from the jpgs
+        const QString source_dir = data_path_ + "/.meta/thumbnails";
+        const QString pack_path = ThumbnailProvider::packPath();
+        QFile::remove(pack_path);
+        ThumbnailProvider::clearScaledCopies();
+        ThumbnailProvider::reloadPack();
+
+        if (!QDir(source_dir).exists()) {
+            break;
+        }
+
+        // Decoding and scaling thousands of jpgs takes a while
+        bool built = false;
+        co_await runInWorkerThread([&]() {
+            built = ThumbnailPack::build(source_dir, pack_path, ThumbnailProvider::PACK_WIDTH);
+        });
+
+        if (built) {
+            ThumbnailProvider::reloadPack();
+        }
+    } while (build_thumbnail_pack_again_);
+
+    building_thumbnail_pack_ = false;
+}
+
 bool VrpManager::parseMetadata()
 {
     QFile file(data_path_ + "/VRP-GameList.txt");
@@ -183,6 +251,7 @@ bool VrpManager::parseMetadata()
     while (it.hasNext()) {
         it.next();
         if (it.value() == Status::Downloadable) {
+            games_by_package_.remove(it.key().package_name, it.key());
             it.remove();
         }
     }
@@ -206,9 +275,11 @@ bool VrpManager::parseMetadata()
             game_info.version_code = parts[3];
             game_info.last_updated = parts[4];
             game_info.size = parts[5];
+            game_info.intern();
 
             if (!all_games_.contains(game_info)) {
                 all_games_[game_info] = Status::Downloadable;
+                games_by_package_.insert(game_info.package_name, game_info);
                 is_empty = false;
             }
         }
@@ -219,6 +290,11 @@ bool VrpManager::parseMetadata()
         return false;
     } else {
         qDebug() << "Metadata parsed successfully";
+        // New releases haven't been matched against the device yet
+        if (device_connected_) {
+            updateGameStatus({}, true);
+        }
+        saveGamesInfo();
         emit gamesInfoChanged();
         return true;
     }
@@ -237,14 +313,14 @@ QString VrpManager::getLocalGamePath(const QString &release_name) const
     return data_path_ + "/" + release_name;
 }
 
-QString VrpManager::getGameThumbnailPath(const QString &package_name)
+QString VrpManager::getExtractionManifestPath(const QString &release_name) const
 {
-    auto path = data_path_ + "/.meta/thumbnails/" + package_name + ".jpg";
-    if (QFile::exists(path)) {
-        return path;
-    } else {
-        return "";
-    }
+    return data_path_ + "/.extracted/" + release_name + ".json";
+}
+
+bool VrpManager::isExtracted(const GameInfo &game) const
+{
+    return ExtractionManifest::isIntact(getExtractionManifestPath(game.release_name), data_path_);
 }
 
 bool VrpManager::addToDownloadQueue(const GameInfo game)
@@ -262,9 +338,16 @@ bool VrpManager::addToDownloadQueue(const GameInfo game)
         return false;
     }
 
-    // Decompression failure is most likely due to a corrupted download file, delete the cache and start downloading from scratch
+    // e.g. after games_info.json was lost, the volumes are usually cleaned from the cache by then
+    if (s != Status::DecompressionError && isExtracted(game)) {
+        qDebug() << "Already decompressed: " << game.release_name;
+        finishDecompression(game);
+        return true;
+    }
+
+    // Decompression failure is most likely due to a corrupted download file, the bad volumes are found and fetched again
     if (s == Status::DecompressionError) {
-        cleanCache(game.release_name);
+        repair_releases_.insert(game.release_name);
     }
 
     download_games_->remove(game);
@@ -301,6 +384,7 @@ bool VrpManager::removeLocalGameFile(const GameInfo &game)
 {
     setStatus(game, Status::Downloadable);
     auto game_dir = getLocalGamePath(game.release_name);
+    QFile::remove(getExtractionManifestPath(game.release_name));
 
     QDir dir(game_dir);
     if (dir.exists()) {
@@ -313,23 +397,59 @@ QCoro::Task<void> VrpManager::downloadQueuedGames()
 {
     GameInfo game = getFirstQueuedGame();
     while (game != GameInfo{}) {
+        QString id = getGameId(game.release_name);
+
+        if (repair_releases_.remove(game.release_name)) {
+            const int discarded = co_await http_downloader_.verifyDir(id);
+            if (discarded > 0) {
+                qDebug() << "Downloading" << discarded << "bad volumes again: " << game.release_name;
+            } else {
+                // Nothing to single out, start from scratch
+                qDebug() << "No bad volume found, downloading everything again: " << game.release_name;
+                cleanCache(game.release_name);
+            }
+        }
+
+        // The listed size is in MB, whatever was downloaded before is already on disk
+        const QString reservation_key = "download:" + game.release_name;
+        if (!co_await space_reservations_.reserve(reservation_key, cache_path_ + "/" + id, game.size.toLongLong() * 1024 * 1024)) {
+            setStatus(game, Status::DownloadError);
+            game = getFirstQueuedGame();
+            continue;
+        }
+
+        // Removed from the queue while waiting for space
+        if (getStatus(game) != Status::Queued) {
+            space_reservations_.release(reservation_key);
+            game = getFirstQueuedGame();
+            continue;
+        }
+
         qDebug() << "Downloading: " << game.release_name;
         setStatus(game, Status::Downloading);
 
-        QString id = getGameId(game.release_name);
-
         auto conn = connect(&http_downloader_,
                             &HttpDownloader::downloadProgressDir,
                             this,
-                            [this, id, game](QString dir_name, qint64 bytes_received, qint64 bytes_total) {
+                            [this, id, release_name = game.release_name](QString dir_name, qint64 bytes_received, qint64 bytes_total) {
                                 if (dir_name == id) {
-                                    emit downloadProgressChanged(game.release_name, double(bytes_received) / double(bytes_total));
+                                    emit downloadProgressChanged(release_name, double(bytes_received) / double(bytes_total));
                                 }
                             });
 
-        if (co_await http_downloader_.downloadDir(id)) {
+        bool downloaded = co_await http_downloader_.downloadDir(id);
+        space_reservations_.release(reservation_key);
+
+        if (downloaded) {
             qDebug() << "Download finished: " << game.release_name;
-            decompressGame(game);
+            touchGame(game.release_name);
+            // Renamed packages have to be rewritten on disk, those always go through decompression
+            if (settings()->installFromArchive() && DeviceManager::archiveInstallSupported() && !settings()->renamePackage()
+                && device_manager_->hasConnectedDevice()) {
+                installFromArchive(game);
+            } else {
+                decompressGame(game);
+            }
         } else {
             if (getStatus(game) == Status::Downloading) {
                 setStatus(game, Status::DownloadError);
@@ -352,16 +472,50 @@ QCoro::Task<bool> VrpManager::decompressGame(const GameInfo game)
     qDebug() << "Decompressing: " << game.release_name;
     setStatus(game, Status::Decompressing);
 
+    const QString archive_path = QString("%1/%2/%2.7z.001").arg(cache_path_, getGameId(game.release_name));
+    const QList<ArchiveEntry> entries = co_await SevenZip::list(archive_path, vrp_public_.password());
+
+    // An earlier extraction of the same archive may still be there, e.g. after games_info.json was lost
+    const QString manifest_path = getExtractionManifestPath(game.release_name);
+    bool extracted = false;
+    if (!entries.isEmpty()) {
+        co_await runInWorkerThread([&]() {
+            extracted = ExtractionManifest::matches(manifest_path, data_path_, entries);
+        });
+    }
+    if (extracted) {
+        qDebug() << "Already decompressed: " << game.release_name;
+        finishDecompression(game);
+        co_return true;
+    }
+    QFile::remove(manifest_path);
+
+    // Reserve the unpacked size from the archive headers
+    const QString reservation_key = "decompress:" + game.release_name;
+    const qint64 unpacked_size = SevenZip::unpackedSize(entries);
+    if (!co_await space_reservations_.reserve(reservation_key, getLocalGamePath(game.release_name), unpacked_size)) {
+        qDebug() << "Decompression failed: " << game.release_name;
+        setStatus(game, Status::DecompressionError);
+        co_return false;
+    }
+
     QProcess basic_process;
     auto p7za = qCoro(basic_process);
 
-    // Decompress
-    p7za.start(P7ZA,
-               QStringList() << "x" << QString("%1/%2/%2.7z.001").arg(cache_path_, getGameId(game.release_name))
-                             << "-aoa" // Overwrite All existing files without prompt.
-                             << QString("-o%1").arg(data_path_) << QString("-p%1").arg(vrp_public_.password()));
+    // Decompress, a stalled 7za is killed and started over once since -aoa overwrites what it already extracted
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        p7za.start(P7ZA,
+                   QStringList() << "x" << archive_path
+                                 << "-aoa" // Overwrite All existing files without prompt.
+                                 << "-bsp1" // Report progress on stdout, it keeps the watchdog fed
+                                 << QString("-o%1").arg(data_path_) << QString("-p%1").arg(vrp_public_.password()));
 
-    co_await p7za.waitForFinished(-1);
+        if (co_await ProcessWatchdog::waitForFinished(basic_process)) {
+            break;
+        }
+        qWarning() << "Decompression stalled: " << game.release_name;
+    }
+    space_reservations_.release(reservation_key);
 
     if (basic_process.exitStatus() != QProcess::NormalExit || basic_process.exitCode() != 0) {
         qWarning("Error: %s\n %s", basic_process.readAllStandardOutput().data(), basic_process.readAllStandardError().data());
@@ -370,25 +524,29 @@ QCoro::Task<bool> VrpManager::decompressGame(const GameInfo game)
         co_return false;
     } else {
         qDebug() << "Decompression finished: " << game.release_name;
+        ExtractionManifest::save(manifest_path, data_path_, entries);
+        finishDecompression(game);
+        co_return true;
+    }
+}
 
-        if (device_manager_->hasConnectedDevice()) {
-            setStatus(game, Status::Installable);
-        } else {
-            setStatus(game, Status::Local);
-        }
+void VrpManager::finishDecompression(const GameInfo &game)
+{
+    // The device may have the package already, appListChanged only reports packages that change on it
+    setStatus(game, Status::Local);
+    updateGameStatus({game.package_name}, false);
 
-        download_games_->remove(game);
-        local_games_->prepend(game);
+    download_games_->remove(game);
+    local_games_->prepend(game);
 
-        if (settings()->autoInstall() && device_manager_->hasConnectedDevice()) {
-            install(game);
-        }
+    if (settings()->autoInstall() && device_manager_->hasConnectedDevice()) {
+        install(game);
+    }
 
-        if (settings()->autoCleanCache()) {
-            cleanCache(game.release_name);
-        }
-        co_return true;
+    if (settings()->autoCleanCache()) {
+        cleanCache(game.release_name);
     }
+    enforceQuotas();
 }
 
 QCoro::Task<bool> VrpManager::install(const GameInfo game)
@@ -396,13 +554,26 @@ QCoro::Task<bool> VrpManager::install(const GameInfo game)
     if (!device_manager_->hasConnectedDevice()) {
         co_return false;
     }
-    qDebug() << "Installing: " << game.release_name;
-    setStatus(game, Status::Installing);
+
+    static constexpr StatusFlags install_flags = {Status::InstallQueued, Status::Staging, Status::Installing};
+    if (install_flags.testFlag(getStatus(game))) {
+        qDebug() << "Already in install queue: " << game.release_name;
+        co_return false;
+    }
+
+    qDebug() << "Queued for install: " << game.release_name;
+    setStatus(game, Status::InstallQueued);
+
+    auto conns = trackInstall(game);
     bool result = co_await device_manager_->installApk(getLocalGamePath(game.release_name), game.package_name, settings()->renamePackage());
+    for (const auto &conn : conns) {
+        disconnect(conn);
+    }
 
     if (result) {
         qDebug() << "Install finished: " << game.release_name;
         setStatus(game, Status::InstalledAndLocally);
+        touchGame(game.release_name);
     } else {
         qDebug() << "Install failed: " << game.release_name;
         setStatus(game, Status::InstallError);
@@ -411,6 +582,162 @@ QCoro::Task<bool> VrpManager::install(const GameInfo game)
     co_return result;
 }
 
+QList<QMetaObject::Connection> VrpManager::trackInstall(const GameInfo &game)
+{
+    QList<QMetaObject::Connection> conns;
+    conns << connect(device_manager_,
+                     &DeviceManager::installStateChanged,
+                     this,
+                     [this, game](QString serial, QString package_name, DeviceManager::InstallState state) {
+                         Q_UNUSED(serial);
+                         if (package_name != game.package_name) {
+                             return;
+                         }
+
+                         if (state == DeviceManager::Staging) {
+                             setStatus(game, Status::Staging);
+                         } else if (state == DeviceManager::Installing) {
+                             qDebug() << "Installing: " << game.release_name;
+                             setStatus(game, Status::Installing);
+                         }
+                     });
+
+    conns << connect(device_manager_,
+                     &DeviceManager::pushProgressChanged,
+                     this,
+                     [this, game](QString serial, QString package_name, qint64 bytes_pushed, qint64 bytes_total, double bytes_per_second) {
+                         Q_UNUSED(serial);
+                         if (package_name == game.package_name && bytes_total > 0) {
+                             emit installProgressChanged(game.release_name, double(bytes_pushed) / double(bytes_total), bytes_per_second);
+                         }
+                     });
+    return conns;
+}
+
+QCoro::Task<bool> VrpManager::installFromArchive(const GameInfo game)
+{
+    qDebug() << "Queued for install from archive: " << game.release_name;
+    archive_installs_.insert(game.release_name);
+    setStatus(game, Status::InstallQueued);
+
+    auto conns = trackInstall(game);
+    bool result = co_await device_manager_->installApkFromArchive(QString("%1/%2/%2.7z.001").arg(cache_path_, getGameId(game.release_name)),
+                                                                  vrp_public_.password(),
+                                                                  game.package_name);
+    for (const auto &conn : conns) {
+        disconnect(conn);
+    }
+    archive_installs_.remove(game.release_name);
+
+    if (!result) {
+        // Nothing is lost, the archive is still in the cache
+        qWarning() << "Install from archive failed, decompressing instead: " << game.release_name;
+        co_return co_await decompressGame(game);
+    }
+
+    qDebug() << "Install finished: " << game.release_name;
+    setStatus(game, Status::InstalledAndRemotely);
+    download_games_->remove(game);
+    touchGame(game.release_name);
+
+    if (settings()->autoCleanCache()) {
+        cleanCache(game.release_name);
+    }
+    enforceQuotas();
+    co_return true;
+}
+
+QCoro::Task<QVariantMap> VrpManager::installToDevices(const GameInfo game, const QStringList serials)
+{
+    static constexpr StatusFlags install_flags = {Status::InstallQueued, Status::Staging, Status::Installing};
+    if (install_flags.testFlag(getStatus(game)) || busy_releases_.contains(game.release_name)) {
+        qDebug() << "Already in install queue: " << game.release_name;
+        QVariantMap results;
+        for (const QString &serial : serials) {
+            results[serial] = false;
+        }
+        co_return results;
+    }
+
+    // Only the connected device is reflected in the game status
+    QString serial = device_manager_->connectedDevice();
+    bool track_status = serials.contains(serial);
+    if (track_status) {
+        setStatus(game, Status::Installing);
+    }
+
+    qDebug() << "Installing: " << game.release_name << "to devices" << serials;
+    busy_releases_.insert(game.release_name);
+    auto conn = connect(device_manager_,
+                        &DeviceManager::pushProgressChanged,
+                        this,
+                        [this, game, serial](QString serial_, QString package_name, qint64 bytes_pushed, qint64 bytes_total, double bytes_per_second) {
+                            if (serial_ == serial && package_name == game.package_name && bytes_total > 0) {
+                                emit installProgressChanged(game.release_name, double(bytes_pushed) / double(bytes_total), bytes_per_second);
+                            }
+                        });
+    QVariantMap results =
+        co_await device_manager_->installApkToDevices(serials, getLocalGamePath(game.release_name), game.package_name, settings()->renamePackage());
+    disconnect(conn);
+    busy_releases_.remove(game.release_name);
+
+    for (const QVariant &result : results) {
+        if (result.toBool()) {
+            touchGame(game.release_name);
+            break;
+        }
+    }
+
+    if (track_status) {
+        setStatus(game, results.value(serial).toBool() ? Status::InstalledAndLocally : Status::InstallError);
+    }
+    co_return results;
+}
+
+void VrpManager::setStatus(const GameInfo &game, Status status)
+{
+    auto it = all_games_.find(game);
+    if (it == all_games_.end()) {
+        return;
+    }
+
+    // Only changes that survive a restart are worth journaling, most transitions don't
+    const Status old_persistent_status = persistentStatus(game, it.value());
+    const Status new_persistent_status = persistentStatus(game, status);
+    it.value() = status;
+    if (new_persistent_status != old_persistent_status) {
+        appendToJournal(game.release_name, {{"status", QString(QMetaEnum::fromType<Status>().valueToKey(new_persistent_status))}});
+    }
+    emit statusChanged(game.release_name, status);
+}
+
+VrpManager::Status VrpManager::persistentStatus(const GameInfo &game, Status status) const
+{
+    switch (status) {
+    case Status::Downloading:
+    case Status::DownloadError:
+    case Status::Decompressing:
+    case Status::DecompressionError:
+        return Status::Queued;
+    case Status::InstallQueued:
+    case Status::Staging:
+    case Status::Installing:
+        // Archive installs have nothing on disk yet, they resume from the download queue
+        return archive_installs_.contains(game.release_name) ? Status::Queued : Status::Local;
+    case Status::Installable:
+    case Status::InstallError:
+    case Status::UpdatableLocally:
+    case Status::InstalledAndLocally:
+        return Status::Local;
+    case Status::UpdatableRemotely:
+    case Status::InstalledAndRemotely:
+    case Status::Unknown:
+        return Status::Downloadable;
+    default:
+        return status;
+    }
+}
+
 bool VrpManager::saveGamesInfo()
 {
     QJsonArray jsonArray;
@@ -420,53 +747,41 @@ bool VrpManager::saveGamesInfo()
     while (it != all_games_.constEnd()) {
         QJsonObject jsonObject;
         const GameInfo &game = it.key();
-        Status status = it.value();
         jsonObject["name"] = game.name;
         jsonObject["release_name"] = game.release_name;
         jsonObject["package_name"] = game.package_name;
         jsonObject["version_code"] = game.version_code;
         jsonObject["last_updated"] = game.last_updated;
         jsonObject["size"] = game.size;
-
-        switch (status) {
-        case Status::Downloading:
-        case Status::DownloadError:
-        case Status::Decompressing:
-        case Status::DecompressionError:
-            status = Status::Queued;
-            break;
-        case Status::Installable:
-        case Status::Installing:
-        case Status::InstallError:
-        case Status::UpdatableLocally:
-        case Status::InstalledAndLocally:
-            status = Status::Local;
-            break;
-        case Status::UpdatableRemotely:
-        case Status::InstalledAndRemotely:
-            status = Downloadable;
-            break;
-        case Status::Unknown:
-            status = Status::Downloadable;
-        default:
-            break;
+        if (last_used_.contains(game.release_name)) {
+            jsonObject["last_used"] = last_used_.value(game.release_name);
+        }
+        if (pinned_.contains(game.release_name)) {
+            jsonObject["pinned"] = true;
         }
 
-        auto status_key = meta_status.valueToKey(status);
+        auto status_key = meta_status.valueToKey(persistentStatus(game, it.value()));
         jsonObject["status"] = QString(status_key);
         jsonArray.append(jsonObject);
         ++it;
     }
 
+    // Written to a temporary file and renamed, a crash leaves either the old or the new catalog
     QJsonDocument jsonDoc(jsonArray);
-    QFile file(data_path_ + "/games_info.json");
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(jsonDoc.toJson());
-        return true;
-    } else {
+    QSaveFile file(data_path_ + "/games_info.json");
+    if (!file.open(QIODevice::WriteOnly)) {
         qWarning("save games info: Failed to open file for writing.");
         return false;
     }
+
+    file.write(jsonDoc.toJson());
+    if (!file.commit()) {
+        qWarning() << "save games info: Failed to write" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    resetJournal();
+    return true;
 }
 
 bool VrpManager::loadGamesInfo()
@@ -478,34 +793,71 @@ bool VrpManager::loadGamesInfo()
     }
 
     all_games_.clear();
+    games_by_package_.clear();
 
     if (file.open(QIODevice::ReadOnly)) {
         QByteArray data = file.readAll();
         QJsonDocument jsonDoc(QJsonDocument::fromJson(data));
         QJsonArray jsonArray = jsonDoc.array();
         auto meta_status = QMetaEnum::fromType<Status>();
+        const QHash<QString, QJsonObject> journal = readJournal();
+        QList<GameInfo> download_games;
+        QList<GameInfo> local_games;
+        bool extracted_games = false;
         for (const auto &value : jsonArray) {
             GameInfo game;
             auto obj = value.toObject();
+            // Changes since games_info.json was written, in case the app didn't exit cleanly
+            const QJsonObject changes = journal.value(obj["release_name"].toString());
+            for (auto it = changes.constBegin(); it != changes.constEnd(); ++it) {
+                obj[it.key()] = it.value();
+            }
+
             game.name = obj["name"].toString();
             game.release_name = obj["release_name"].toString();
             game.package_name = obj["package_name"].toString();
             game.version_code = obj["version_code"].toString();
             game.last_updated = obj["last_updated"].toString();
-            game.size = value.toObject()["size"].toString();
+            game.size = obj["size"].toString();
+            game.intern();
+            if (obj.contains("last_used")) {
+                last_used_[game.release_name] = obj["last_used"].toInteger();
+            }
+            if (obj["pinned"].toBool()) {
+                pinned_.insert(game.release_name);
+            }
 
             int status_int = meta_status.keyToValue(obj["status"].toString().toUtf8());
 
             Status status = status_int >= 0 ? static_cast<Status>(status_int) : Status::Unknown;
+            // Queued again although the extraction is still there, no need to download it
+            if (status == Status::Queued && isExtracted(game)) {
+                qDebug() << "Already decompressed: " << game.release_name;
+                status = Status::Local;
+                extracted_games = true;
+            }
             all_games_[game] = status;
+            games_by_package_.insert(game.package_name, game);
             if (status == Status::Queued || status == Status::Downloading || status == Status::DownloadError || status == Status::Decompressing
                 || status == Status::DecompressionError) {
-                download_games_->append(game);
+                download_games.append(game);
             } else if (status == Status::Local || status == Status::Installable || status == Status::InstalledAndLocally || status == Status::InstallError) {
-                local_games_->append(game);
+                local_games.append(game);
             }
         }
 
+        // One model update each instead of one per game
+        download_games_->append(download_games);
+        local_games_->append(local_games);
+
+        // Also drops a torn last line, so new entries don't get appended to it
+        if (QFileInfo(journalPath()).size() > 0) {
+            qDebug() << "Recovered changes to" << journal.size() << "games from" << journalPath();
+            saveGamesInfo();
+        } else if (extracted_games) {
+            saveGamesInfo();
+        }
+
         emit gamesInfoChanged();
         return true;
     } else {
@@ -514,43 +866,101 @@ bool VrpManager::loadGamesInfo()
     }
 }
 
-void VrpManager::updateGameStatusWithDevice()
+QString VrpManager::journalPath() const
 {
-    auto apps_model = device_manager_->appListModel();
-    StatusFlags remote_flags = {Status::UpdatableRemotely, Status::InstalledAndRemotely};
+    return data_path_ + "/games_info.journal";
+}
 
-    StatusFlags local_flags = {Status::UpdatableLocally, Status::InstalledAndLocally, Status::Installable, Status::InstallError, Status::Installing};
-
-    if (apps_model->rowCount() == 0) {
-        // Update Status
-        QMutableMapIterator<GameInfo, Status> it(all_games_);
-        while (it.hasNext()) {
-            it.next();
-
-            Status s = it.value();
-            if (remote_flags.testFlag(s)) {
-                it.setValue(Status::Downloadable);
-                emit statusChanged(it.key().release_name, Status::Downloadable);
-            } else if (local_flags.testFlag(s)) {
-                it.setValue(Status::Local);
-                emit statusChanged(it.key().release_name, Status::Local);
-            }
+QHash<QString, QJsonObject> VrpManager::readJournal() const
+{
+    // Release name -> latest value of every field that changed
+    QHash<QString, QJsonObject> changes;
+    QFile file(journalPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return changes;
+    }
+
+    while (!file.atEnd()) {
+        QJsonParseError error;
+        QJsonObject entry = QJsonDocument::fromJson(file.readLine(), &error).object();
+        // The last line is cut short if the app died while writing it
+        if (error.error != QJsonParseError::NoError) {
+            continue;
         }
 
-        return;
+        const QString release_name = entry.take("release_name").toString();
+        if (release_name.isEmpty()) {
+            continue;
+        }
+        QJsonObject &change = changes[release_name];
+        for (auto it = entry.constBegin(); it != entry.constEnd(); ++it) {
+            change[it.key()] = it.value();
+        }
     }
+    return changes;
+}
 
-    QMap<QString, QString> installed_map;
-    for (int i = 0; i < apps_model->rowCount(); i++) {
-        auto app = (*apps_model)[i];
-        installed_map[app.package_name] = app.version_code;
+void VrpManager::appendToJournal(const QString &release_name, const QJsonObject &change)
+{
+    if (!journal_.isOpen()) {
+        journal_.setFileName(journalPath());
+        if (!journal_.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "Failed to open" << journal_.fileName() << journal_.errorString();
+            return;
+        }
     }
 
-    // Update game status
-    QMutableMapIterator<GameInfo, Status> it(all_games_);
-    while (it.hasNext()) {
-        it.next();
-        Status from_s = it.value();
+    QJsonObject entry = change;
+    entry["release_name"] = release_name;
+    journal_.write(QJsonDocument(entry).toJson(QJsonDocument::Compact) + '\n');
+    // Hand it to the os right away, it's what survives a crash
+    journal_.flush();
+
+    if (++journal_entries_ >= JOURNAL_COMPACT_ENTRIES) {
+        saveGamesInfo();
+    }
+}
+
+void VrpManager::resetJournal()
+{
+    // Only called once games_info.json holds everything the journal did
+    journal_.close();
+    journal_.setFileName(journalPath());
+    if (!journal_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to truncate" << journal_.fileName() << journal_.errorString();
+    }
+    journal_entries_ = 0;
+}
+
+void VrpManager::updateGameStatusWithDevice(const QStringList &changed_packages)
+{
+    // Connecting or disconnecting changes every local game between Installable and Local, otherwise only the changed packages matter
+    const bool connected = device_manager_->hasConnectedDevice();
+    const bool update_all = connected != device_connected_;
+    device_connected_ = connected;
+
+    const QSet<QString> changed(changed_packages.begin(), changed_packages.end());
+    if (update_all || !changed.isEmpty()) {
+        updateGameStatus(changed, update_all);
+    }
+}
+
+void VrpManager::updateGameStatus(const QSet<QString> &changed, bool update_all)
+{
+    const bool connected = device_connected_;
+    StatusFlags remote_flags = {Status::UpdatableRemotely, Status::InstalledAndRemotely};
+
+    StatusFlags local_flags = {Status::UpdatableLocally, Status::InstalledAndLocally, Status::Installable, Status::InstallError};
+    // Games in the install queue get their final status when the install finishes
+    StatusFlags install_flags = {Status::InstallQueued, Status::Staging, Status::Installing};
+
+    // Release name -> new status, published in one go
+    QVariantMap statuses;
+    auto update = [&](const GameInfo &game, Status &status) {
+        Status from_s = status;
+        if (install_flags.testFlag(from_s)) {
+            return;
+        }
 
         if (local_flags.testFlag(from_s)) {
             from_s = Status::Local;
@@ -558,23 +968,42 @@ void VrpManager::updateGameStatusWithDevice()
             from_s = Status::Downloadable;
         }
 
-        QString package_name = it.key().package_name;
-        QString release_name = it.key().release_name;
-        if (installed_map.contains(package_name)) {
-            Status to_s;
-            if (it.key().version_code.toLongLong() > installed_map[package_name].toLongLong()) {
+        Status to_s = from_s;
+        const QString installed_version = connected ? device_manager_->installedVersionCode(game.package_name) : QString();
+        if (!installed_version.isNull()) {
+            if (game.version_code.toLongLong() > installed_version.toLongLong()) {
                 to_s = from_s == Status::Local ? Status::UpdatableLocally : Status::UpdatableRemotely;
             } else {
                 to_s = from_s == Status::Local ? Status::InstalledAndLocally : Status::InstalledAndRemotely;
             }
-            it.setValue(to_s);
-            emit statusChanged(release_name, to_s);
+        } else if (connected && from_s == Status::Local) {
+            to_s = Status::Installable;
+        }
 
-        } else if (from_s == Status::Local) {
-            it.setValue(Status::Installable);
-            emit statusChanged(release_name, Status::Installable);
+        if (to_s != status) {
+            status = to_s;
+            statuses.insert(game.release_name, int(to_s));
+        }
+    };
+
+    if (update_all) {
+        for (auto it = all_games_.begin(); it != all_games_.end(); ++it) {
+            update(it.key(), it.value());
+        }
+    } else {
+        for (const QString &package_name : changed) {
+            for (const GameInfo &game : games_by_package_.values(package_name)) {
+                auto it = all_games_.find(game);
+                if (it != all_games_.end()) {
+                    update(it.key(), it.value());
+                }
+            }
         }
     }
+
+    if (!statuses.isEmpty()) {
+        emit statusesChanged(statuses);
+    }
 }
 
 GameInfo VrpManager::getDownloadingGame() const
@@ -633,3 +1062,139 @@ void VrpManager::restartMainApp()
     qApp->exit(AppSettings::EXIT_RESTART);
     QProcess::startDetached(program, arguments);
 }
+
+void VrpManager::setPinned(const QString &release_name, bool pinned)
+{
+    if (pinned == pinned_.contains(release_name)) {
+        return;
+    }
+
+    if (pinned) {
+        pinned_.insert(release_name);
+    } else {
+        pinned_.remove(release_name);
+        enforceQuotas();
+    }
+    appendToJournal(release_name, {{"pinned", pinned}});
+    emit pinnedChanged(release_name, pinned);
+}
+
+void VrpManager::touchGame(const QString &release_name)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    last_used_[release_name] = now;
+    appendToJournal(release_name, {{"last_used", now}});
+}
+
+bool VrpManager::isCacheEvictable(const GameInfo &game) const
+{
+    // Volumes of queued and unfinished downloads are still needed
+    static constexpr StatusFlags busy_flags = {Status::Queued, Status::Downloading, Status::DownloadError, Status::Decompressing, Status::DecompressionError};
+    return !pinned_.contains(game.release_name) && !archive_installs_.contains(game.release_name) && !busy_flags.testFlag(getStatus(game));
+}
+
+bool VrpManager::isDataEvictable(const GameInfo &game) const
+{
+    static constexpr StatusFlags local_flags = {Status::Local, Status::UpdatableLocally, Status::Installable, Status::InstallError, Status::InstalledAndLocally};
+    return !pinned_.contains(game.release_name) && !busy_releases_.contains(game.release_name) && local_flags.testFlag(getStatus(game));
+}
+
+QCoro::Task<void> VrpManager::enforceQuotas()
+{
+    // One pass at a time, a request during a pass runs it again at the end
+    if (enforcing_quotas_) {
+        enforce_quotas_again_ = true;
+        co_return;
+    }
+    enforcing_quotas_ = true;
+
+    do {
+        enforce_quotas_again_ = false;
+        const qint64 cache_quota = qint64(settings()->cacheQuota()) * 1024 * 1024;
+        const qint64 data_quota = qint64(settings()->dataQuota()) * 1024 * 1024;
+
+        // Everything on disk counts towards the quota, in use or not
+        QList<DiskEntry> cache_entries;
+        QList<DiskEntry> data_entries;
+        for (auto it = all_games_.cbegin(); it != all_games_.cend(); ++it) {
+            const GameInfo &game = it.key();
+            const QString cache_dir = cache_path_ + "/" + getGameId(game.release_name);
+            const QString data_dir = getLocalGamePath(game.release_name);
+            if (cache_quota > 0 && QFileInfo(cache_dir).isDir()) {
+                cache_entries.append({game, cache_dir});
+            }
+            if (data_quota > 0 && !game.release_name.isEmpty() && QFileInfo(data_dir).isDir()) {
+                data_entries.append({game, data_dir});
+            }
+        }
+
+        if (!cache_entries.isEmpty()) {
+            co_await evictOverQuota(cache_entries, cache_quota, false);
+        }
+        if (!data_entries.isEmpty()) {
+            co_await evictOverQuota(data_entries, data_quota, true);
+        }
+    } while (enforce_quotas_again_);
+
+    enforcing_quotas_ = false;
+}
+
+static qint64 dirSize(const QString &path)
+{
+    qint64 size = 0;
+    QDirIterator it(path, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        size += it.fileInfo().size();
+    }
+    return size;
+}
+
+QCoro::Task<void> VrpManager::evictOverQuota(QList<DiskEntry> entries, qint64 quota, bool local_games)
+{
+    // Walking tens of GB of game files takes a while on slow disks
+    co_await runInWorkerThread([&entries]() {
+        for (auto &entry : entries) {
+            entry.size = dirSize(entry.path);
+        }
+    });
+
+    qint64 usage = 0;
+    for (auto &entry : entries) {
+        usage += entry.size;
+        entry.last_used = last_used_.value(entry.game.release_name, QFileInfo(entry.path).lastModified().toMSecsSinceEpoch());
+    }
+
+    // Least recently downloaded or installed first
+    std::sort(entries.begin(), entries.end(), [](const DiskEntry &a, const DiskEntry &b) {
+        return a.last_used < b.last_used;
+    });
+
+    for (const auto &entry : entries) {
+        if (usage <= quota) {
+            break;
+        }
+
+        // The game may have been queued or pinned while measuring
+        if (local_games ? !isDataEvictable(entry.game) : !isCacheEvictable(entry.game)) {
+            continue;
+        }
+
+        qDebug() << "Over quota, evicting" << entry.path;
+        if (local_games) {
+            // Same as deleting it from the local games list
+            local_games_->remove(entry.game);
+            if (QFileInfo(entry.path).isDir()) {
+                removeLocalGameFile(entry.game);
+            }
+            updateGameStatus({entry.game.package_name}, false);
+        } else {
+            cleanCache(entry.game.release_name);
+        }
+        usage -= entry.size;
+    }
+
+    if (usage > quota) {
+        qWarning() << "Still" << usage - quota << "bytes over quota, everything left is pinned or in use";
+    }
+}
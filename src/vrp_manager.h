@@ -24,14 +24,19 @@
 #include "http_downloader.h"
 #include "models/game_info.h"
 #include "models/game_info_model.h"
+#include "space_reservations.h"
 #include "vrp_public.h"
 #include "vrp_torrent.h"
 #include <QCoroTask>
 #include <QCryptographicHash>
+#include <QFile>
+#include <QJsonObject>
 #include <QMap>
 #include <QMetaEnum>
+#include <QMultiHash>
 #include <QMultiMap>
 #include <QProcess>
+#include <QSet>
 #include <QVariant>
 
 class VrpManager : public QObject
@@ -60,7 +65,9 @@ public:
         Installing = 0x0400,
         InstallError = 0x0800,
         InstalledAndRemotely = 0x1000,
-        InstalledAndLocally = 0x2000
+        InstalledAndLocally = 0x2000,
+        InstallQueued = 0x4000,
+        Staging = 0x8000
     };
     Q_DECLARE_FLAGS(StatusFlags, Status)
     Q_FLAG(Status)
@@ -115,7 +122,11 @@ public:
     {
         return install(game);
     }
-    Q_INVOKABLE QString getGameThumbnailPath(const QString &package_name);
+    QCoro::Task<QVariantMap> installToDevices(const GameInfo game, const QStringList serials);
+    Q_INVOKABLE QCoro::QmlTask installToDevicesQml(const GameInfo game, const QStringList &serials)
+    {
+        return installToDevices(game, serials);
+    }
     Q_INVOKABLE QString getGameId(const QString &release_name) const;
     Q_INVOKABLE QString getLocalGamePath(const QString &release_name) const;
     Q_INVOKABLE QString getMagnetURI(const QString &release_name) const
@@ -131,15 +142,7 @@ public:
     {
         return all_games_[game];
     }
-    void setStatus(const GameInfo &game, Status status)
-    {
-        if (!all_games_.contains(game)) {
-            return;
-        }
-
-        all_games_[game] = status;
-        emit statusChanged(game.release_name, status);
-    }
+    void setStatus(const GameInfo &game, Status status);
 
     QVariantList gamesInfo() const;
     Q_INVOKABLE AppSettings *settings() const
@@ -157,24 +160,62 @@ public:
 
     Q_INVOKABLE void restartMainApp();
 
+    // Pinned games are never evicted to keep the cache and data paths within their quotas
+    Q_INVOKABLE bool isPinned(const QString &release_name) const
+    {
+        return pinned_.contains(release_name);
+    }
+    Q_INVOKABLE void setPinned(const QString &release_name, bool pinned);
+
 signals:
     void gamesInfoChanged();
     void statusChanged(QString release_name, Status status);
+    // Release name -> Status of every game whose status changed together
+    void statusesChanged(QVariantMap statuses);
     void downloadProgressChanged(QString release_name, double progress);
+    void installProgressChanged(QString release_name, double progress, double bytes_per_second);
+    void pinnedChanged(QString release_name, bool pinned);
 
 private:
     QCoro::Task<bool> downloadMetadata();
+    QCoro::Task<void> buildThumbnailPack();
     bool parseMetadata();
     QCoro::Task<bool> decompressGame(const GameInfo game);
+    void finishDecompression(const GameInfo &game);
+    QString getExtractionManifestPath(const QString &release_name) const;
+    // An earlier extraction is still on disk untouched, nothing has to be downloaded
+    bool isExtracted(const GameInfo &game) const;
+    QCoro::Task<bool> installFromArchive(const GameInfo game);
+    QList<QMetaObject::Connection> trackInstall(const GameInfo &game);
     QCoro::Task<void> downloadQueuedGames();
     bool saveGamesInfo();
     bool loadGamesInfo();
+    Status persistentStatus(const GameInfo &game, Status status) const;
+    QString journalPath() const;
+    QHash<QString, QJsonObject> readJournal() const;
+    void appendToJournal(const QString &release_name, const QJsonObject &change);
+    void resetJournal();
     GameInfo getDownloadingGame() const;
     GameInfo getFirstQueuedGame() const;
-    void updateGameStatusWithDevice();
+    void updateGameStatusWithDevice(const QStringList &changed_packages);
+    void updateGameStatus(const QSet<QString> &changed, bool update_all);
+
+    struct DiskEntry {
+        GameInfo game;
+        QString path;
+        qint64 size = 0;
+        qint64 last_used = 0;
+    };
+
+    void touchGame(const QString &release_name);
+    bool isCacheEvictable(const GameInfo &game) const;
+    bool isDataEvictable(const GameInfo &game) const;
+    QCoro::Task<void> enforceQuotas();
+    QCoro::Task<void> evictOverQuota(QList<DiskEntry> entries, qint64 quota, bool local_games);
 
     VrpPublic vrp_public_;
     VrpTorrent vrp_torrent_;
+    SpaceReservations space_reservations_;
     QString cache_path_;
     QString data_path_;
     QString filter_;
@@ -185,6 +226,24 @@ private:
     GameInfoModel *download_games_;
     GameInfoModel *local_games_;
     QMap<GameInfo, Status> all_games_;
+    QMultiHash<QString, GameInfo> games_by_package_;
+    QSet<QString> archive_installs_;
+    // Games whose download is checked for bad volumes before it is resumed
+    QSet<QString> repair_releases_;
+    bool device_connected_;
+    // Release names, by last download or install in ms since epoch
+    QHash<QString, qint64> last_used_;
+    QSet<QString> pinned_;
+    // Games read by an install that doesn't show in their status
+    QSet<QString> busy_releases_;
+    bool enforcing_quotas_;
+    bool enforce_quotas_again_;
+    bool building_thumbnail_pack_;
+    bool build_thumbnail_pack_again_;
+    // Changes since games_info.json was last written, one json object per line.
+    // Replayed on top of games_info.json at startup and emptied whenever it is rewritten.
+    QFile journal_;
+    int journal_entries_;
     HttpDownloader http_downloader_;
 };
 
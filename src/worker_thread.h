@@ -0,0 +1,29 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_WORKER_THREAD
+#define QROOKIE_WORKER_THREAD
+
+#include <QCoroTask>
+#include <functional>
+
+// Run function on a thread of its own and resume once it returned, for disk work that would block the ui.
+// function may capture the caller's locals by reference, the caller is suspended until it is done.
+QCoro::Task<void> runInWorkerThread(std::function<void()> function);
+
+#endif /* QROOKIE_WORKER_THREAD */
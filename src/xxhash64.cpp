@@ -0,0 +1,137 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "xxhash64.h"
+
+#include <QtEndian>
+#include <cstring>
+
+static constexpr quint64 PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr quint64 PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr quint64 PRIME64_3 = 0x165667B19E3779F9ULL;
+static constexpr quint64 PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr quint64 PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline quint64 rotl(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline quint64 stripeRound(quint64 acc, quint64 input)
+{
+    return rotl(acc + input * PRIME64_2, 31) * PRIME64_1;
+}
+
+static inline quint64 mergeRound(quint64 acc, quint64 value)
+{
+    return (acc ^ stripeRound(0, value)) * PRIME64_1 + PRIME64_4;
+}
+
+XxHash64::XxHash64(quint64 seed)
+    : seed_(seed)
+{
+    reset();
+}
+
+void XxHash64::reset()
+{
+    acc_[0] = seed_ + PRIME64_1 + PRIME64_2;
+    acc_[1] = seed_ + PRIME64_2;
+    acc_[2] = seed_;
+    acc_[3] = seed_ - PRIME64_1;
+    total_size_ = 0;
+    buffer_size_ = 0;
+}
+
+void XxHash64::addData(QByteArrayView data)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data.data());
+    const uchar *end = p + data.size();
+    total_size_ += data.size();
+
+    // Top up a partial stripe left by the last call
+    if (buffer_size_ > 0) {
+        const qsizetype length = qMin<qsizetype>(end - p, 32 - buffer_size_);
+        memcpy(buffer_ + buffer_size_, p, length);
+        buffer_size_ += length;
+        p += length;
+        if (buffer_size_ < 32) {
+            return;
+        }
+        for (int i = 0; i < 4; ++i) {
+            acc_[i] = stripeRound(acc_[i], qFromLittleEndian<quint64>(buffer_ + i * 8));
+        }
+        buffer_size_ = 0;
+    }
+
+    // The bulk of the data, 32 byte stripes straight from the input
+    for (; end - p >= 32; p += 32) {
+        acc_[0] = stripeRound(acc_[0], qFromLittleEndian<quint64>(p));
+        acc_[1] = stripeRound(acc_[1], qFromLittleEndian<quint64>(p + 8));
+        acc_[2] = stripeRound(acc_[2], qFromLittleEndian<quint64>(p + 16));
+        acc_[3] = stripeRound(acc_[3], qFromLittleEndian<quint64>(p + 24));
+    }
+
+    memcpy(buffer_, p, end - p);
+    buffer_size_ = end - p;
+}
+
+quint64 XxHash64::result() const
+{
+    quint64 hash;
+    if (total_size_ >= 32) {
+        hash = rotl(acc_[0], 1) + rotl(acc_[1], 7) + rotl(acc_[2], 12) + rotl(acc_[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            hash = mergeRound(hash, acc_[i]);
+        }
+    } else {
+        hash = seed_ + PRIME64_5;
+    }
+    hash += total_size_;
+
+    const uchar *p = buffer_;
+    const uchar *end = buffer_ + buffer_size_;
+    for (; end - p >= 8; p += 8) {
+        hash = rotl(hash ^ stripeRound(0, qFromLittleEndian<quint64>(p)), 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (end - p >= 4) {
+        hash = rotl(hash ^ (quint64(qFromLittleEndian<quint32>(p)) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash = rotl(hash ^ (*p * PRIME64_5), 11) * PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+quint64 XxHash64::hash(QByteArrayView data, quint64 seed)
+{
+    XxHash64 hash(seed);
+    hash.addData(data);
+    return hash.result();
+}
+
+QString XxHash64::toHex(quint64 digest)
+{
+    return QString::number(digest, 16).rightJustified(16, '0');
+}
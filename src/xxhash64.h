@@ -0,0 +1,49 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#ifndef QROOKIE_XXHASH64
+#define QROOKIE_XXHASH64
+
+#include <QByteArrayView>
+#include <QString>
+
+// Streaming XXH64 (https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md).
+// Fast enough to hash volumes as they arrive without slowing the download down.
+class XxHash64
+{
+public:
+    explicit XxHash64(quint64 seed = 0);
+
+    void reset();
+    void addData(QByteArrayView data);
+    quint64 result() const;
+
+    static quint64 hash(QByteArrayView data, quint64 seed = 0);
+
+    // Canonical form, as printed by xxhsum
+    static QString toHex(quint64 digest);
+
+private:
+    quint64 seed_;
+    quint64 acc_[4];
+    quint64 total_size_;
+    uchar buffer_[32];
+    qsizetype buffer_size_;
+};
+
+#endif /* QROOKIE_XXHASH64 */
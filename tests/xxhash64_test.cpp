@@ -0,0 +1,107 @@
+/*
+ Copyright (c) 2024 glaumar <glaumar@geekgo.tech>
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "xxhash64.h"
+
+#include <QTest>
+
+// The short strings are published XXH64 test vectors, the digests of the patterned inputs come from an
+// independent implementation of the specification
+class XxHash64Test : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Deterministic input of any length
+    static QByteArray pattern(qsizetype size)
+    {
+        QByteArray data(size, Qt::Uninitialized);
+        for (qsizetype i = 0; i < size; ++i) {
+            data[i] = char((i * 7 + 3) & 0xff);
+        }
+        return data;
+    }
+
+private slots:
+    void oneShot_data()
+    {
+        QTest::addColumn<QByteArray>("data");
+        QTest::addColumn<QString>("digest");
+
+        QTest::newRow("empty") << QByteArray() << QString("ef46db3751d8e999");
+        QTest::newRow("1 byte") << QByteArray("a") << QString("d24ec4f1a98c6e5b");
+        QTest::newRow("3 bytes") << QByteArray("abc") << QString("44bc2cf5ad770999");
+        QTest::newRow("31 bytes") << pattern(31) << QString("a2aa5f33cc4a6119");
+        QTest::newRow("32 bytes") << pattern(32) << QString("23c3c17ef790fd97");
+        QTest::newRow("33 bytes") << pattern(33) << QString("50a7cfc7ba588784");
+        QTest::newRow("39 bytes") << QByteArray("Nobody inspects the spammish repetition") << QString("fbcea83c8a378bf1");
+        QTest::newRow("100 bytes") << pattern(100) << QString("a61f8d4c170fe531");
+        QTest::newRow("1000 bytes") << pattern(1000) << QString("5f235fa033f1a3fb");
+        QTest::newRow("100003 bytes") << pattern(100003) << QString("924a64f3ae9ea839");
+    }
+
+    void oneShot()
+    {
+        QFETCH(QByteArray, data);
+        QFETCH(QString, digest);
+
+        XxHash64 hash;
+        hash.addData(data);
+        QCOMPARE(XxHash64::toHex(hash.result()), digest);
+        QCOMPARE(XxHash64::toHex(XxHash64::hash(data)), digest);
+    }
+
+    // Volumes are hashed in whatever pieces the network hands out
+    void chunked_data()
+    {
+        QTest::addColumn<qsizetype>("size");
+        QTest::addColumn<qsizetype>("chunk_size");
+        QTest::addColumn<QString>("digest");
+
+        QTest::newRow("32 bytes by 1") << qsizetype(32) << qsizetype(1) << QString("23c3c17ef790fd97");
+        QTest::newRow("33 bytes by 5") << qsizetype(33) << qsizetype(5) << QString("50a7cfc7ba588784");
+        QTest::newRow("1000 bytes by 7") << qsizetype(1000) << qsizetype(7) << QString("5f235fa033f1a3fb");
+        QTest::newRow("1000 bytes by 31") << qsizetype(1000) << qsizetype(31) << QString("5f235fa033f1a3fb");
+        QTest::newRow("100003 bytes by 4099") << qsizetype(100003) << qsizetype(4099) << QString("924a64f3ae9ea839");
+    }
+
+    void chunked()
+    {
+        QFETCH(qsizetype, size);
+        QFETCH(qsizetype, chunk_size);
+        QFETCH(QString, digest);
+
+        const QByteArray data = pattern(size);
+        XxHash64 hash;
+        for (qsizetype pos = 0; pos < data.size(); pos += chunk_size) {
+            hash.addData(QByteArrayView(data).sliced(pos, qMin(chunk_size, data.size() - pos)));
+        }
+        QCOMPARE(XxHash64::toHex(hash.result()), digest);
+    }
+
+    void reset()
+    {
+        XxHash64 hash;
+        hash.addData(pattern(1000));
+        hash.reset();
+        hash.addData(QByteArray("abc"));
+        QCOMPARE(XxHash64::toHex(hash.result()), QString("44bc2cf5ad770999"));
+    }
+};
+
+QTEST_APPLESS_MAIN(XxHash64Test)
+#include "xxhash64_test.moc"